@@ -1,25 +1,85 @@
 /*
  * name: RoboGo
- * version: 1.0.0
+ * version: 1.14.0
  * author: VisualGMQ
  * data: 2021/11/08
  *
  * compile:
- *   g++ main.cpp -o RoboGo -std=c++17
+ *   g++ robogo.cpp -o RoboGo -std=c++17 -pthread
  *
  * note:
  *   This is a console game, so make sure your console's size bigger than 80x25.
+ *   The screen is drawn with ANSI escape codes and write(), so it needs a POSIX terminal.
  *   Or you can change `DefaultCanvaWidth` and `DefaultCanvaHeight` to define your own size.
+ *   --size <w>x<h> plays on a bigger field(up to 4096x4096), the screen shows the part of it
+ *   around the robot. --schedule <file> reads how many bullets come from which turn on, its
+ *   lines are `<turn> <percent>`, a percent over 100 brings more than one bullet a turn.
+ *   Without it, the built-in schedule is scaled to the size of the field.
  *   Press CTRL-C to exit the game(or play it until game over).
+ *   ./RoboGo --seed <n> plays a reproducible game: the same seed and the same robocmd.txt
+ *   always give the same bullets and the same turns.
+ *   ./RoboGo --headless [--seed <n>] [--seeds <count>] [--threads <t>] [--max-turns <m>]
+ *   plays robocmd.txt without screen and sleep, on seeds n, n+1, ... n+count-1 in parallel,
+ *   and prints the turns survived and the turns/sec.
+ *   ./RoboGo --bench-script [--seed <n>] measures how fast the script interpreter runs.
+ *   ./RoboGo --evolve [--generations <g>] [--population <p>] [--seeds <count>] [--threads <t>]
+ *                     [--max-turns <m>] [--seed <n>] [--out <file>]
+ *   searches for the command loop that survives longest on a fixed set of seeds, and writes
+ *   it to robocmd.txt(or <file>), the old one is kept as robocmd.txt.bak.
+ *   ./RoboGo --bench-bullets [--bullets <n>] [--seed <n>] stresses the bullet update with
+ *   n(100000 by default) live bullets on a big field.
+ *   ./RoboGo --bench-parser [--lines <n>] measures loading a script of n(2000000 by default) lines.
+ *   After a game the costs of its turns are shown: the time of every phase of a turn, as
+ *   percentiles, and the live bullets. ./RoboGo --headless --stats shows them for headless games,
+ *   --stats-out <file> [--stats-every <n>] writes them for every n(100 by default) turns too.
+ *   ./RoboGo --record <file> [--headless] saves every turn of the game into file,
+ *   ./RoboGo --replay <file> checks it, with --turn <n> shows the screen of turn n,
+ *   and with --play [--delay <ms>] plays it from there(turn 0 by default).
+ *   ./RoboGo --arena <script or directory> ... [--seeds <count>] [--threads <t>] [--max-turns <m>]
+ *   puts a robot for each script into the same bullets, and ranks them by the turns survived.
+ *   ./RoboGo --bench-auto [--seed <n>] measures how long the autopilot plans a turn, against
+ *   the number of bullets.
+ *   ./RoboGo --test runs the unittests.
  *
  * description:
  *   RoboGo is a game that you lead the robot(@) to avoid bullets, and live as long as you can.
  *   You write your commands into `./robocmd.txt`,
  *   then this game will read `./robocmd.txt`(if not exists, it will generate one, which include some help text and an example) and execute your commands.
  *   Commands are executed in a loop, so you needn't write your commands duplicately.
+ *   While playing, save `./robocmd.txt` again and the robot runs the new commands from the next
+ *   turn(Linux only, by inotify), no need to restart the game.
+ *   Besides the moves, a script has repeat blocks, labels and jumps, and `if` on the bullets
+ *   near the robot. It is compiled once into bytecode, so its logic costs nearly nothing a turn.
+ *   `auto <n>` hands the robot to the autopilot for n turns, it looks where the bullets will be
+ *   in the next turns and takes the move that keeps it alive the longest.
  *
  *   If bullets collide on your robot, you die.
  *   The difficulty will increase by turn increasing.
+ *
+ * log:
+ *   1.1.0: a frame is composed in one buffer and written once, only changed rows are sent.
+ *   1.2.0: one seedable random engine for the game, added --seed.
+ *   1.3.0: headless fast-forward mode to evaluate a robocmd.txt over many seeds.
+ *   1.4.0: robocmd.txt is compiled to bytecode, added repeat, label/jump, if near/bullet
+ *          and --bench-script.
+ *   1.5.0: --evolve, a parallel genetic search for scripts on a work stealing pool.
+ *   1.6.0: bullets are kept in arrays by direction, only live ones are updated, and
+ *          they are removed once out of the field; added --bench-bullets.
+ *   1.7.0: hits are found on a grid of the cells bullets swept this turn, one lookup a robot;
+ *          walking into a bullet kills in that turn, not the next one.
+ *   1.8.0: robocmd.txt is reloaded while playing when it is saved, by an inotify thread.
+ *   1.9.0: scripts are mmap()ed and compiled in one pass without copying a line, lines of
+ *          any length; added --bench-parser.
+ *   1.10.0: binary turn traces written by a background thread, --record and --replay with
+ *           keyframes to seek.
+ *   1.11.0: --arena, hundreds of robots with their own scripts in one game, and a leaderboard.
+ *   1.12.0: `auto <n>` command, an autopilot searching a map of where the bullets will be,
+ *           with a fixed budget a turn; added --bench-auto.
+ *   1.13.0: fields up to 4096x4096 with --size, only a view around the robot is drawn;
+ *           the difficulty comes from a schedule table, --schedule reads one; hits are looked
+ *           up in the danger map, a turn no longer writes a cell for every bullet.
+ *   1.14.0: per turn counters and log-linear latency histograms of the turn's phases, shown at
+ *           game over, --stats for headless games, --stats-out streams them.
  */
 #include <iostream>
 #include <thread>
@@ -31,6 +91,27 @@
 #include <string_view>
 #include <chrono>
 #include <cassert>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <filesystem>
+#include <cstdio>
+#include <charconv>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
 
 /***************************
  * some alias and constexpr
@@ -44,8 +125,7 @@ using Ref = std::shared_ptr<T>;
 
 constexpr int DefaultCanvaWidth = 80;
 constexpr int DefaultCanvaHeight = 22;
-
-bool clsClear = true;
+constexpr int MaxFieldSide = 4096;
 
 /*****************************************
  * some math function and math structures
@@ -72,6 +152,53 @@ struct Rect {
 };
 
 
+/*****************************************
+ * random: a seedable engine for the game
+*****************************************/
+
+// xoshiro128** seeded by splitmix64, fast and the same on every platform
+class Random {
+public:
+    explicit Random(uint64_t seed = 0) { Seed(seed); }
+
+    void Seed(uint64_t seed) {
+        for (int i = 0; i < 4; i += 2) {
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            z ^= z >> 31;
+            state_[i] = uint32_t(z);
+            state_[i + 1] = uint32_t(z >> 32);
+        }
+    }
+
+    uint32_t Next() {
+        uint32_t result = rotl(state_[1] * 5, 7) * 9;
+        uint32_t t = state_[1] << 9;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = rotl(state_[3], 11);
+        return result;
+    }
+
+    // in [low, high], by multiply and shift instead of std::uniform_int_distribution,
+    // whose results differ between standard libraries
+    int Int(int low, int high) {
+        uint64_t range = uint64_t(int64_t(high) - low + 1);
+        return low + int((uint64_t(Next()) * range) >> 32);
+    }
+
+private:
+    uint32_t state_[4];
+
+    static uint32_t rotl(uint32_t x, int k) {
+        return (x << k) | (x >> (32 - k));
+    }
+};
+
 /*****************
  * some symbols
 *****************/
@@ -95,20 +222,38 @@ struct BoxStyle {
 constexpr BoxStyle BlockBox = { '#', '#', '#'};
 constexpr BoxStyle WallBox = {'|', '-', '.'};
 
+// the size of the field, --size sets it before any game starts
+Size FieldSize = {DefaultCanvaWidth, DefaultCanvaHeight};
+
+// the field may be much bigger than the screen, so only the chars in the view are kept,
+// the view is at most the default canvas and draws outside it are dropped
 class Surface {
 public:
-    Surface(): Surface({DefaultCanvaWidth, DefaultCanvaHeight}) {}
+    Surface(): Surface(FieldSize) {}
 
     Surface(const Size& size): size_(size) {
-        data_.resize(size.w * size.h, ' ');
+        view_ = {{0, 0}, {std::min(size.w, DefaultCanvaWidth), std::min(size.h, DefaultCanvaHeight)}};
+        data_.resize(view_.size.w * view_.size.h, ' ');
     }
 
     const Size& GetSize() const { return size_; }
 
+    const Rect& GetView() const { return view_; }
+
+    // moves the view to have pos in its middle, as far as the field goes
+    void Follow(const Point& pos) {
+        view_.pos.x = std::clamp(pos.x - view_.size.w / 2, 0, size_.w - view_.size.w);
+        view_.pos.y = std::clamp(pos.y - view_.size.h / 2, 0, size_.h - view_.size.h);
+    }
+
+    // a row of the view
+    const char* GetRow(int y) const { return data_.data() + y * view_.size.w; }
+
     char GetChar(const Point& pos) {
-        if (pos.x >= 0 && pos.y >= 0 &&
-            pos.x < size_.w && pos.y < size_.h) {
-            return data_.at(pos.x + pos.y * size_.w);
+        int x = pos.x - view_.pos.x, y = pos.y - view_.pos.y;
+        if (x >= 0 && y >= 0 &&
+            x < view_.size.w && y < view_.size.h) {
+            return data_.at(x + y * view_.size.w);
         }
         return -1;
     }
@@ -119,27 +264,29 @@ public:
     }
 
     void DrawChar(const Point& pos, char c) {
-        if (pos.x >= 0 && pos.y >= 0 &&
-            pos.x < size_.w && pos.y < size_.h) {
-            data_[pos.x + pos.y * size_.w] = c;
+        int x = pos.x - view_.pos.x, y = pos.y - view_.pos.y;
+        if (x >= 0 && y >= 0 &&
+            x < view_.size.w && y < view_.size.h) {
+            data_[x + y * view_.size.w] = c;
         }
     }
 
+    // lines are cut to the view, a side of a big field is not walked char by char
     void DrawVLine(int x, int y1, int y2, char c = '|') {
-        y1 = std::min(y1, y2);
-        y2 = std::max(y1, y2);
-        while (y1 <= y2) {
-            DrawChar({x, y1}, c);
-            y1 ++;
+        int low = std::max(std::min(y1, y2), view_.pos.y);
+        int high = std::min(std::max(y1, y2), view_.pos.y + view_.size.h - 1);
+        while (low <= high) {
+            DrawChar({x, low}, c);
+            low ++;
         }
     }
 
     void DrawHLine(int y, int x1, int x2, char c = '-') {
-        x1 = std::min(x1, x2);
-        x2 = std::max(x1, x2);
-        while (x1 <= x2) {
-            DrawChar({x1, y}, c);
-            x1 ++;
+        int low = std::max(std::min(x1, x2), view_.pos.x);
+        int high = std::min(std::max(x1, x2), view_.pos.x + view_.size.w - 1);
+        while (low <= high) {
+            DrawChar({low, y}, c);
+            low ++;
         }
     }
 
@@ -157,7 +304,8 @@ public:
 
 private:
     Size size_;
-    std::vector<char> data_;
+    Rect view_;
+    std::vector<char> data_;    // the chars of the view
 };
 
 /*****************
@@ -173,6 +321,7 @@ enum CmdType {
     MOVE_DOWN,
 
     REST,
+    AUTO,
 
     EXIT_GAME,
 };
@@ -185,30 +334,122 @@ struct CmdRest {
     int num;
 };
 
+struct CmdAuto {
+    int num;
+};
+
 struct Cmd {
     CmdType type = INVALID;
     union {
         CmdMove move;
         CmdRest rest;
+        CmdAuto autopilot;
     };
 };
 
 Cmd ParserCmd(const std::string&);
-std::vector<Cmd> ReadCmdFromFile(const std::string& filename);
+Cmd ParserCmd(const std::string_view* words, int count);
+
+/*********************************************
+ * script: robocmd.txt compiled into bytecode
+ ********************************************/
+
+enum OpCode: uint8_t {
+    // actions, each takes n turns
+    OP_MOVE,        // dir: which way
+    OP_REST,
+    OP_AUTO,        // the autopilot picks the move
+    OP_EXIT,
+
+    // control, takes no turn
+    OP_JUMP,        // to target
+    OP_REPEAT,      // counter = n, to target if n <= 0
+    OP_LOOP,        // to target while --counter > 0
+    OP_IF_NEAR,     // to target unless a bullet within n cells (or if one, when negate)
+    OP_IF_BULLET,   // to target unless a bullet n cells away at dir side flies to us
+};
+
+struct Op {
+    OpCode code;
+    uint8_t dir;
+    bool negate;
+    uint16_t counter;
+    int32_t n;
+    int32_t target;
+};
+
+struct Program {
+    std::vector<Op> ops;
+    int counters = 0;   // one for each repeat block
+};
+
+bool CompileScript(std::string_view source, Program& program, std::string& error);
+bool LoadScript(const std::string& filename, Program& program, std::string& error);
+Program ReadScriptFromFile(const std::string& filename);
 
 /************
  * some func
  ***********/
 
 void ClearScreen();
-void UpdateScreen(Surface* surface);
-void _detectClearWay();
-std::vector<std::string_view> SplitStrBySpace(const std::string&);
+void UpdateScreen(Surface* surface, const std::string& status);
+void WriteAll(const char* data, size_t size);
+int SplitWords(std::string_view line, std::string_view* words, int max);
+bool ParseInt(std::string_view s, int& value);
 int RandInt(int low, int high);
 void DebugPrintCmd(const Cmd&);
 
 void Init();
 
+/******************************************
+ * renderer: one buffer, one write() a frame
+ *****************************************/
+
+class Renderer {
+public:
+    Renderer(const Size& size): size_(size) {
+        prev_.resize(size.w * size.h, ' ');
+        // every row with its cursor move, and the status line
+        buffer_.reserve(size.h * (size.w + 16) + 256);
+    }
+
+    // next frame sends every row
+    void Invalidate() { full_ = true; }
+
+    // only rows that differ from the last frame are sent, unless Invalidate()
+    void Present(const Surface* surface, const std::string& status) {
+        buffer_.clear();
+        int w = std::min(size_.w, surface->GetView().size.w);
+        int h = std::min(size_.h, surface->GetView().size.h);
+        for (int y = 0; y < h; y++) {
+            const char* row = surface->GetRow(y);
+            char* prev = prev_.data() + y * size_.w;
+            if (!full_ && std::memcmp(row, prev, w) == 0)
+                continue;
+            moveCursor(y, 0);
+            buffer_.append(row, w);
+            std::memcpy(prev, row, w);
+        }
+        full_ = false;
+        moveCursor(h, 0);
+        buffer_.append(status);
+        buffer_.append("\x1b[K\n");
+        WriteAll(buffer_.data(), buffer_.size());
+    }
+
+private:
+    Size size_;
+    std::vector<char> prev_;
+    std::string buffer_;
+    bool full_ = true;
+
+    void moveCursor(int y, int x) {
+        char seq[32];
+        int n = std::snprintf(seq, sizeof(seq), "\x1b[%d;%dH", y + 1, x + 1);
+        buffer_.append(seq, n);
+    }
+};
+
 /******************
  * some unittests
  *****************/
@@ -218,12 +459,26 @@ void TestCmdParser() {
     assert(cmd.type == MOVE_RIGHT);
 }
 
+void TestCompileScript() {
+    Program program;
+    std::string error;
+    assert(CompileScript("right 3\nrepeat 2\n  if near 2\n    auto 1\n  end\nend\n", program, error));
+    // a count under 1 would never finish its command
+    for (const char* source : {"right 0", "rest 0", "auto -1", "up -3"}) {
+        assert(!CompileScript(std::string("rest 1\n") + source + "\n", program, error));
+        assert(error == "2: bad number: " + std::string(source));
+    }
+    (void)error;
+}
+
 
 /****************
  * game related
  ***************/
 
-Unique<Surface> surface(new Surface);
+// per-game state is thread_local, so the headless mode can play one game on each thread
+thread_local Unique<Surface> surface(new Surface);
+Renderer renderer({DefaultCanvaWidth, DefaultCanvaHeight});  // a view is never bigger
 
 class Robo {
 public:
@@ -234,17 +489,33 @@ public:
     }
 };
 
-Robo player;
+thread_local Robo player;
 
 void GameLoop();
-void DealCmd(Cmd&);
-
-bool NextCmd = false;
-
-bool ShouldExit = false;
-std::vector<Cmd> CmdList;
-
-int TurnCount = 0;
+void MoveRobo(Point& pos, int dir);
+void ResetGame(uint64_t seed, const Program& program);
+int BulletGenCondition(int turn);
+void PlayTurn(bool draw);
+int RunHeadless(const Program& program, uint64_t seed, int maxTurns);
+class TurnStats;
+void EvaluateScript(uint64_t seed, int seeds, int threads, int maxTurns, TurnStats* stats);
+void BenchScript(uint64_t seed);
+void RunArena(const std::vector<std::string>& files, uint64_t seed, int seeds, int threads, int maxTurns);
+void BenchBullets(uint64_t seed, int count);
+void BenchAutopilot(uint64_t seed);
+void BenchParser(int lines);
+int ReplayTrace(const std::string& filename, int turn, bool play, int delay);
+void EvolveScripts(uint64_t seed, int seeds, int threads, int maxTurns,
+                   int generations, int population, const std::string& out);
+std::string ScriptToText(const Program& program);
+
+thread_local bool ShouldExit = false;
+Program Script;     // read only once loaded, shared by all games
+
+thread_local int TurnCount = 0;
+
+thread_local uint64_t GameSeed = 0;
+thread_local Random GameRandom;  // every random thing of the game comes from here
 
 struct Bullet {
     enum Direction {
@@ -253,19 +524,191 @@ struct Bullet {
         UP,
         DOWN
     } direction;
-    bool valid = false;
     Point pos;
 };
 
-class BulletCollection {
+/*************************************************
+ * schedule: how many bullets come in which turn
+ ************************************************/
+
+struct ScheduleStep {
+    int turn;       // from this turn on
+    int percent;    // percent / 100 new bullets a turn on average
+};
+
+// the difficulty tuned for the 80x22 field
+const std::vector<ScheduleStep> DefaultSchedule = {
+    {0, 30}, {21, 40}, {41, 50}, {61, 60}, {81, 70}, {101, 80}, {121, 90},
+};
+
+std::vector<ScheduleStep> Schedule = DefaultSchedule;    // read only once the game starts
+
+bool LoadSchedule(const std::string& filename, std::vector<ScheduleStep>& schedule, std::string& error);
+std::vector<ScheduleStep> ScaleSchedule(const std::vector<ScheduleStep>& schedule, const Size& size);
+int SpawnBullets(int turn, std::vector<Bullet>& spawned);
+std::string ViewNote();
+
+constexpr Point BulletStep[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+constexpr char BulletSymbol[4] = {SYM_BULLET_LEFT, SYM_BULLET_RIGHT, SYM_BULLET_UP, SYM_BULLET_DOWN};
+
+// live bullets flying one way, as arrays of x and y; a bullet is removed by moving the last one into it
+struct BulletGroup {
+    std::vector<int> x;
+    std::vector<int> y;
+
+    int Size() const { return x.size(); }
+
+    void Add(const Point& pos) {
+        x.push_back(pos.x);
+        y.push_back(pos.y);
+    }
+
+    void Remove(int i) {
+        x[i] = x.back();
+        x.pop_back();
+        y[i] = y.back();
+        y.pop_back();
+    }
+};
+
+/*******************************************************
+ * danger map: where the bullets are in the next turns
+ ******************************************************/
+
+// the turns the autopilot looks ahead at most
+constexpr int DangerHorizon = 32;
+
+// a bullet flies straight, one cell a turn, so it stands still in the frame moving with its
+// group: each group is a bit map keyed by pos - turn * step, changed only when a bullet is
+// added or leaves, and "is a bullet on pos t turns later" is one lookup a group.
+// two bullets of a group on one key fly together and leave together, so a bit is enough
+class DangerMap {
 public:
-    BulletCollection() {
-        bullets_.resize(20);
+    bool Active() const { return active_; }
+    const Size& GetSize() const { return size_; }
+
+    void Build(const Size& size, const BulletGroup* groups) {
+        size_ = size;
+        gone_.clear();
+        for (int d = 0; d < 4; d++) {
+            // the moving side is long enough to hold a bullet from the step before to the horizon
+            frames_[d] = BulletStep[d].y == 0 ? Size{size.w + DangerHorizon + 2, size.h}
+                                              : Size{size.w, size.h + DangerHorizon + 2};
+            bits_[d].assign((frames_[d].w * frames_[d].h + 63) / 64, 0);
+            origin_[d] = 0;
+            for (int i = 0; i < groups[d].Size(); i++)
+                Add(d, groups[d].x[i], groups[d].y[i]);
+        }
+        active_ = true;
+    }
+
+    // the bullets made one step; the ones that left the step before are forgotten only now,
+    // a bullet ending on the wall still hits there in the turn it is removed
+    void NextTurn() {
+        for (auto [d, k] : gone_)
+            bits_[d][k >> 6] &= ~(uint64_t(1) << (k & 63));
+        gone_.clear();
+        for (int d = 0; d < 4; d++) {
+            int length = BulletStep[d].y == 0 ? frames_[d].w : frames_[d].h;
+            origin_[d] = (origin_[d] + BulletStep[d].x + BulletStep[d].y + length) % length;
+        }
+    }
+
+    void Add(int d, int x, int y) {
+        int k = key(d, x, y, 0);
+        if (k >= 0)
+            bits_[d][k >> 6] |= uint64_t(1) << (k & 63);
+    }
+
+    void Remove(int d, int x, int y) {
+        int k = key(d, x, y, 0);
+        if (k >= 0)
+            gone_.push_back({d, k});
+    }
+
+    // is a bullet on pos t turns later(0 is now, -1 is before the last step), t <= DangerHorizon
+    bool At(const Point& pos, int t) const {
+        for (int d = 0; d < 4; d++) {
+            int k = key(d, pos.x, pos.y, t);
+            if (k >= 0 && (bits_[d][k >> 6] >> (k & 63) & 1))
+                return true;
+        }
+        return false;
+    }
+
+    // is a bullet of group d now on a cell of x0..x1 x y0..y1, all of them on the field;
+    // a row of the rectangle is at most two runs of bits, tested a word at a time
+    bool Any(int d, int x0, int y0, int x1, int y1) const {
+        const Size& f = frames_[d];
+        const std::vector<uint64_t>& bits = bits_[d];
+        for (int y = y0; y <= y1; y++) {
+            int row, from;
+            if (BulletStep[d].y == 0) {
+                row = y;
+                from = x0 - origin_[d];
+                from += from < 0 ? f.w : 0;
+            } else {
+                row = y - origin_[d];
+                row += row < 0 ? f.h : 0;
+                from = x0;
+            }
+            int to = from + x1 - x0, base = row * f.w;
+            if (to < f.w) {
+                if (anyBits(bits, base + from, base + to))
+                    return true;
+            } else if (anyBits(bits, base + from, base + f.w - 1) || anyBits(bits, base, base + to - f.w)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    bool active_ = false;
+    Size size_ = {0, 0};
+    Size frames_[4];
+    int origin_[4];     // how far the frame moved, turns * step along its side
+    std::vector<uint64_t> bits_[4];     // by Bullet::Direction
+    std::vector<std::pair<int, int>> gone_;     // group and bit of the bullets left this step
+
+    // the bit of a bullet of group d on (x, y) t turns later, -1 if it is beside the field;
+    // x, y and the origin are inside the frame and t is short of its side, so no division
+    int key(int d, int x, int y, int t) const {
+        const Size& f = frames_[d];
+        if (BulletStep[d].y == 0) {
+            if (unsigned(y) >= unsigned(f.h))
+                return -1;
+            x -= origin_[d] + t * BulletStep[d].x;
+            x += x < 0 ? f.w : x >= f.w ? -f.w : 0;
+        } else {
+            if (unsigned(x) >= unsigned(f.w))
+                return -1;
+            y -= origin_[d] + t * BulletStep[d].y;
+            y += y < 0 ? f.h : y >= f.h ? -f.h : 0;
+        }
+        return x + y * f.w;
+    }
+
+    // is a bit of k0..k1 set
+    static bool anyBits(const std::vector<uint64_t>& bits, int k0, int k1) {
+        int w0 = k0 >> 6, w1 = k1 >> 6;
+        uint64_t first = ~uint64_t(0) << (k0 & 63), last = ~uint64_t(0) >> (63 - (k1 & 63));
+        if (w0 == w1)
+            return bits[w0] & first & last;
+        if (bits[w0] & first)
+            return true;
+        for (int i = w0 + 1; i < w1; i++) {
+            if (bits[i])
+                return true;
+        }
+        return bits[w1] & last;
     }
+};
 
-    void GenNewBullet() {
+class BulletCollection {
+public:
+    Bullet GenNewBullet() {
         Bullet b;
-        b.valid = true;
         b.pos = {0, 0};
         b.direction = static_cast<Bullet::Direction>(RandInt(0, 3));
         if (b.direction == Bullet::LEFT ||
@@ -279,314 +722,2473 @@ public:
                 b.pos.y = surface->GetSize().h;
         }
 
-        bullets_[findValidSlot()] = b;
+        AddBullet(b);
+        return b;
+    }
+
+    void AddBullet(const Bullet& b) {
+        danger().Add(b.direction, b.pos.x, b.pos.y);
+        groups_[b.direction].Add(b.pos);
+    }
+
+    const DangerMap& Danger() { return danger(); }
+
+    // a robot stood at from while the bullets moved, then went to to;
+    // a bullet flying into it, or it walking onto a bullet, both hit
+    bool Hit(const Point& from, const Point& to) {
+        const DangerMap& map = danger();
+        return map.At(from, -1) || map.At(from, 0) || map.At(to, 0);
     }
 
-    void Update() {
-        for (auto& b : bullets_) {
-            if (b.pos == player.pos) {
-                ShouldExit = true;
+    const BulletGroup& Group(int direction) const { return groups_[direction]; }
+
+    // bullets are drawn into surface only when draw is true
+    // the hits are found later by Hit(), after the robot moved
+    void Update(bool draw = true) {
+        const int w = surface->GetSize().w, h = surface->GetSize().h;
+        DangerMap& map = danger();
+        map.NextTurn();
+        for (int d = 0; d < 4; d++) {
+            BulletGroup& g = groups_[d];
+            int* x = g.x.data();
+            int* y = g.y.data();
+            const int n = g.Size(), dx = BulletStep[d].x, dy = BulletStep[d].y;
+
+            if (draw) {
+                for (int i = 0; i < n; i++)
+                    surface->DrawChar({x[i], y[i]}, BulletSymbol[d]);
             }
-            switch (b.direction) {
-                case Bullet::LEFT:
-                    surface->DrawChar(b.pos, SYM_BULLET_LEFT);
-                    b.pos.x --;
-                    break;
-                case Bullet::RIGHT:
-                    surface->DrawChar(b.pos, SYM_BULLET_RIGHT);
-                    b.pos.x ++;
-                    break;
-                case Bullet::UP:
-                    surface->DrawChar(b.pos, SYM_BULLET_UP);
-                    b.pos.y --;
-                    break;
-                case Bullet::DOWN:
-                    surface->DrawChar(b.pos, SYM_BULLET_DOWN);
-                    b.pos.y ++;
-                    break;
+
+            // no branch, the compiler can vectorize it
+            for (int i = 0; i < n; i++) {
+                x[i] += dx;
+                y[i] += dy;
+            }
+
+            // the ones out of the field are gone
+            for (int i = 0; i < g.Size();) {
+                if (x[i] <= 0 || x[i] >= w || y[i] <= 0 || y[i] >= h) {
+                    map.Remove(d, x[i], y[i]);
+                    g.Remove(i);
+                } else
+                    i++;
             }
-            if (b.pos.x <= 0 || b.pos.x >= surface->GetSize().w ||
-                b.pos.y <= 0 || b.pos.y >= surface->GetSize().h) {
-                b.valid = false;
+        }
+    }
+
+    int Count() const {
+        return groups_[0].Size() + groups_[1].Size() + groups_[2].Size() + groups_[3].Size();
+    }
+
+    // the bullets the arrays hold before they grow
+    size_t Capacity() const {
+        return groups_[0].x.capacity() + groups_[1].x.capacity() + groups_[2].x.capacity() + groups_[3].x.capacity();
+    }
+
+    // is a bullet within d cells of pos, in both x and y;
+    // the cells around pos are looked up in the danger map, or the bullets are when they are fewer
+    bool Near(const Point& pos, int d) {
+        // live bullets are on 1..w-1 x 1..h-1, the map also keeps the ones that left this step
+        const Size& size = surface->GetSize();
+        int x0 = std::max(pos.x - d, 1), x1 = std::min(pos.x + d, size.w - 1),
+            y0 = std::max(pos.y - d, 1), y1 = std::min(pos.y + d, size.h - 1);
+        if (x0 > x1 || y0 > y1)
+            return false;
+        if (int64_t(y1 - y0 + 1) * 4 <= Count()) {
+            const DangerMap& map = danger();
+            for (int g = 0; g < 4; g++) {
+                if (map.Any(g, x0, y0, x1, y1))
+                    return true;
             }
-            if (b.pos == player.pos) {
-                ShouldExit = true;
+            return false;
+        }
+        for (auto& g : groups_) {
+            const int* x = g.x.data();
+            const int* y = g.y.data();
+            int found = 0;
+            for (int i = 0; i < g.Size(); i++)
+                found |= (std::abs(x[i] - pos.x) <= d) & (std::abs(y[i] - pos.y) <= d);
+            if (found)
+                return true;
+        }
+        return false;
+    }
+
+    // is a bullet at most d cells away at the side of pos, and flying to pos
+    bool Coming(const Point& pos, int side, int d) {
+        // a bullet at our left flies right, and so on
+        static const int opposite[4] = {Bullet::RIGHT, Bullet::LEFT, Bullet::DOWN, Bullet::UP};
+        const BulletGroup& g = groups_[opposite[side]];
+        bool horizontal = side == Bullet::LEFT || side == Bullet::RIGHT;
+        const Size& size = surface->GetSize();
+        if (horizontal ? pos.y < 1 || pos.y > size.h - 1 : pos.x < 1 || pos.x > size.w - 1)
+            return false;
+
+        // the cells from pos to d away, a row is one lookup and a column one a cell
+        int low = side == Bullet::LEFT || side == Bullet::UP ? -d : 1,
+            high = side == Bullet::LEFT || side == Bullet::UP ? -1 : d;
+        int cells = horizontal ? 1 : high - low + 1;
+        if (cells <= g.Size()) {
+            if (horizontal) {
+                int x0 = std::max(pos.x + low, 1), x1 = std::min(pos.x + high, size.w - 1);
+                return x0 <= x1 && danger().Any(opposite[side], x0, pos.y, x1, pos.y);
             }
+            int y0 = std::max(pos.y + low, 1), y1 = std::min(pos.y + high, size.h - 1);
+            return y0 <= y1 && danger().Any(opposite[side], pos.x, y0, pos.x, y1);
         }
+
+        const int* along = horizontal ? g.x.data() : g.y.data();
+        const int* across = horizontal ? g.y.data() : g.x.data();
+        const int a = horizontal ? pos.x : pos.y,
+                  c = horizontal ? pos.y : pos.x,
+                  sign = (side == Bullet::LEFT || side == Bullet::UP) ? 1 : -1;
+        int found = 0;
+        for (int i = 0; i < g.Size(); i++) {
+            int dist = (a - along[i]) * sign;
+            found |= (across[i] == c) & (dist > 0) & (dist <= d);
+        }
+        return found;
     }
 
 private:
-    std::vector<Bullet> bullets_;
-
-    int findValidSlot() {
-        for (int i = 0; i < bullets_.size(); i++)
-            if (!bullets_[i].valid)
-                return i;
-        bullets_.resize(bullets_.size() * 2);
-        return bullets_.size() / 2;
+    BulletGroup groups_[4];     // by Bullet::Direction
+    DangerMap danger_;
+
+    // the map follows the field, it is built again when the field changed
+    DangerMap& danger() {
+        const Size& size = surface->GetSize();
+        if (!danger_.Active() || danger_.GetSize().w != size.w || danger_.GetSize().h != size.h)
+            danger_.Build(size, groups_);
+        return danger_;
     }
 };
 
-BulletCollection BulCollection;
+thread_local BulletCollection BulCollection;
 
-/****************
- * main function
- ***************/
+/**********************************************
+ * autopilot: the safest move for this turn
+ *********************************************/
 
-int main(int argc, char** argv) {
-    Init();
-    GameLoop();
-    return 0;
-}
+// the cells looked at a turn at most, so a plan costs about the same however many bullets fly;
+// it is counted in cells and not in time, so a game still plays the same on every machine
+constexpr int PlanBudget = 4096;
+constexpr int WallWeight = 16;   // a cell away from the wall counts as this many next to it
 
-/****************************
- * function implementations
-****************************/
+// a breadth first search over the cells the robot can be on in the next turns, the move kept
+// is the one that lives the most turns, then the one leaving the most cells to be on;
+// a cell next to the wall counts less, a new bullet may come in there without warning
+class Autopilot {
+public:
+    // the direction to move this turn, -1 to rest
+    int Plan(const Point& pos, const DangerMap& danger) {
+        // the robot gets at most DangerHorizon cells away, so the cells are kept in a window
+        // around it that wide, whatever the field; a side of a small field is taken whole,
+        // there a cell is known by where it is and not by how far, as the robot may go round
+        const int w = danger.GetSize().w, h = danger.GetSize().h;
+        const int ww = std::min(w, 2 * DangerHorizon + 1), wh = std::min(h, 2 * DangerHorizon + 1);
+        if (int(stamp_.size()) != ww * wh || base_ > UINT32_MAX - DangerHorizon - 1) {
+            stamp_.assign(ww * wh, 0);
+            slot_.assign(ww * wh, 0);
+            base_ = 0;
+        }
 
-int RandInt(int low, int high) {
-    std::random_device d;
-    std::uniform_int_distribution<int> dist(low, high);
-    return dist(d);
-}
+        // moves 0..3 are Bullet::Direction, 4 is rest; every cell keeps the first moves leading to it
+        static const int order[5] = {4, Bullet::LEFT, Bullet::RIGHT, Bullet::UP, Bullet::DOWN};
+        int counts[5] = {0};
+        int looked = 0;
+        depth_ = 0;
+        cur_.assign(1, {pos.x, pos.y, 0, 0, 0});
+        for (int t = 1; t <= DangerHorizon; t++) {
+            if (t > 1 && looked + 5 * int(cur_.size()) > PlanBudget)
+                break;
+            base_ ++;
+            next_.clear();
+            for (const Cell& c : cur_) {
+                for (int m = 0; m < 5; m++) {
+                    Point q = {c.x, c.y};
+                    int ox = c.ox, oy = c.oy;
+                    if (m < 4) {
+                        MoveRobo(q, m);
+                        ox += BulletStep[m].x;
+                        oy += BulletStep[m].y;
+                    }
+                    uint8_t moves = t == 1 ? 1 << m : c.moves;
+                    int i = (ww == w ? q.x : ox + DangerHorizon) + (wh == h ? q.y : oy + DangerHorizon) * ww;
+                    looked ++;
+                    if (stamp_[i] == base_) {
+                        if (slot_[i] >= 0)
+                            next_[slot_[i]].moves |= moves;
+                        continue;
+                    }
+                    stamp_[i] = base_;
+                    // it stands there while the bullets make step t, as BulletCollection::Hit() sees it
+                    if (danger.At(q, t - 1) || danger.At(q, t)) {
+                        slot_[i] = -1;
+                        continue;
+                    }
+                    slot_[i] = next_.size();
+                    next_.push_back({q.x, q.y, int16_t(ox), int16_t(oy), moves});
+                }
+            }
+            if (next_.empty())
+                break;      // nothing lives t turns, the last counts stand
+            std::swap(cur_, next_);
+            depth_ = t;
+            std::fill(counts, counts + 5, 0);
+            for (const Cell& c : cur_) {
+                int weight = c.x <= 1 || c.x >= w - 1 || c.y <= 1 || c.y >= h - 1 ? 1 : WallWeight;
+                for (int m = 0; m < 5; m++)
+                    counts[m] += (c.moves >> m & 1) * weight;
+            }
+        }
 
-void ClearScreen() {
-    if (clsClear)
-        system("cls");
-    else
-        system("clear");
-}
+        int best = 4;
+        for (int m : order)
+            if (counts[m] > counts[best])
+                best = m;
+        return best == 4 ? -1 : best;
+    }
+
+    // the turns looked ahead by the last plan
+    int Depth() const { return depth_; }
+
+private:
+    struct Cell {
+        int x;
+        int y;
+        int16_t ox;     // how far from the robot
+        int16_t oy;
+        uint8_t moves;
+    };
+    std::vector<Cell> cur_;
+    std::vector<Cell> next_;
+    std::vector<uint32_t> stamp_;   // base_ when the cell was looked at in this step, by the window
+    std::vector<int> slot_;         // its place in next_, -1 if a bullet gets it
+    uint32_t base_ = 0;
+    int depth_ = 0;
+};
+
+thread_local Autopilot Pilot;
+
+/*********************************
+ * script runner: the interpreter
+ ********************************/
 
-void _detectClearWay() {
-    if (system("clear") == 0) {
-        clsClear = false;
+// a loop without any action stops here, and the robot rests this turn
+constexpr int MaxOpsPerTurn = 1000;
+
+class ScriptRunner {
+public:
+    void Reset(const Program* program) {
+        program_ = program;
+        pc_ = 0;
+        left_ = 0;
+        started_ = false;
+        counters_.assign(program->counters, 0);
     }
-}
 
-void UpdateScreen(Surface* surface) {
-    for (int y = 0; y < surface->GetSize().h; y++) {
-        for (int x = 0; x < surface->GetSize().w; x++) {
-            if (x < DefaultCanvaWidth && y < DefaultCanvaHeight) {
-                std::putchar(surface->GetChar({x, y}));
+    // runs the control ops until one action is done for this turn, returns how many ops ran;
+    // the robot at pos is moved, exit is set by the exit command
+    int Turn(Point& pos, bool& exit) {
+        const Op* ops = program_->ops.data();
+        int size = program_->ops.size();
+        if (size == 0)
+            return 0;
+        for (int executed = 1; executed <= MaxOpsPerTurn; executed++) {
+            if (pc_ >= size)
+                pc_ = 0;    // commands are executed in a loop
+            const Op& op = ops[pc_];
+            switch (op.code) {
+                case OP_MOVE:
+                case OP_REST:
+                case OP_AUTO:
+                    if (!started_) {
+                        left_ = op.n;
+                        started_ = true;
+                    }
+                    if (op.code == OP_MOVE) {
+                        MoveRobo(pos, op.dir);
+                    } else if (op.code == OP_AUTO) {
+                        int dir = Pilot.Plan(pos, BulCollection.Danger());
+                        if (dir >= 0)
+                            MoveRobo(pos, dir);
+                    }
+                    if (--left_ == 0) {
+                        started_ = false;
+                        pc_ ++;
+                    }
+                    return executed;
+                case OP_EXIT:
+                    exit = true;
+                    return executed;
+                case OP_JUMP:
+                    pc_ = op.target;
+                    break;
+                case OP_REPEAT:
+                    counters_[op.counter] = op.n;
+                    pc_ = op.n > 0 ? pc_ + 1 : op.target;
+                    break;
+                case OP_LOOP:
+                    pc_ = --counters_[op.counter] > 0 ? op.target : pc_ + 1;
+                    break;
+                case OP_IF_NEAR:
+                    pc_ = BulCollection.Near(pos, op.n) != op.negate ? pc_ + 1 : op.target;
+                    break;
+                case OP_IF_BULLET:
+                    pc_ = BulCollection.Coming(pos, op.dir, op.n) != op.negate ? pc_ + 1 : op.target;
+                    break;
             }
         }
-        std::cout << std::endl;
+        return MaxOpsPerTurn;
     }
-}
 
-void Init() {
-    _detectClearWay();
-    player.pos.x = surface->GetSize().w / 2;
-    player.pos.y = surface->GetSize().h / 2;
-    CmdList = ReadCmdFromFile("robocmd.txt");
-}
-
-std::vector<std::string_view> SplitStrBySpace(const std::string& s) {
-    std::vector<std::string_view> result;
-    const char* ptr = s.data();
-    const char* prev = ptr;
-    int len = 0;
-    while (*ptr != '\0') {
-        if (*ptr != ' ') {
-            len ++;
-            ptr ++;
-        } else {
-            result.push_back(std::string_view(prev, len));
-            len = 0;
-            while (*ptr == ' ' && *ptr != '\0')
-                ptr ++;
-            prev = ptr;
+private:
+    const Program* program_ = nullptr;
+    int pc_ = 0;
+    int left_ = 0;          // turns left of the current action
+    bool started_ = false;
+    std::vector<int> counters_;
+};
+
+thread_local ScriptRunner Runner;
+
+/**********************************************************
+ * script watcher: reloads robocmd.txt when it is saved
+ *********************************************************/
+
+struct ScriptReload {
+    bool ok = false;
+    Program program;
+    std::string message;
+};
+
+// the file is read and compiled on the watcher's thread, the game only takes the result
+// at a turn boundary, so the game loop never touches the file
+class ScriptWatcher {
+public:
+    ~ScriptWatcher() { Stop(); }
+
+    void Start(const std::string& filename) {
+#ifdef __linux__
+        size_t slash = filename.rfind('/');
+        path_ = filename;
+        name_ = slash == std::string::npos ? filename : filename.substr(slash + 1);
+        std::string dir = slash == std::string::npos ? "." : filename.substr(0, slash);
+
+        // watch the directory, editors often save by writing another file and renaming it
+        inotify_ = inotify_init1(IN_CLOEXEC);
+        if (inotify_ < 0)
+            return;
+        if (inotify_add_watch(inotify_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+            pipe(wake_) < 0) {
+            close(inotify_);
+            inotify_ = -1;
+            return;
         }
+        thread_ = std::thread([this]() { watch(); });
+#endif
     }
-    if (ptr != prev) {
-        result.push_back(std::string_view(prev, len));
-    }
-    return result;
-}
 
-Cmd ParserCmd(const std::string& s) {
-    Cmd cmd;
-    auto views = SplitStrBySpace(s);
-    if (views.size() == 2) {
-        if (views[0] == "right") {
-            cmd.type = MOVE_RIGHT;
-            cmd.move.num = atoi(views[1].data());
-        } else if (views[0] == "left") {
-            cmd.type = MOVE_LEFT;
-            cmd.move.num = atoi(views[1].data());
-        } else if (views[0] == "up") {
-            cmd.type = MOVE_UP;
-            cmd.move.num = atoi(views[1].data());
-        } else if (views[0] == "down") {
-            cmd.type = MOVE_DOWN;
-            cmd.move.num = atoi(views[1].data());
-        } else if (views[0] == "rest") {
-            cmd.type = REST;
-            cmd.move.num = atoi(views[1].data());
-        }
-    }
-    if (views.size() == 1) {
-        if (views[0] == "exit")
-            cmd.type = EXIT_GAME;
+    void Stop() {
+        if (!thread_.joinable())
+            return;
+        char c = 0;
+        if (write(wake_[1], &c, 1) < 0) {}
+        thread_.join();
+        close(inotify_);
+        close(wake_[0]);
+        close(wake_[1]);
+        delete pending_.exchange(nullptr);
     }
-    return cmd;
-}
 
-std::vector<Cmd> ReadCmdFromFile(const std::string& filename) {
-    std::ifstream file(filename);
-    char buf[64] = {0};
-    std::vector<Cmd> result;
+    // the newest reload since the last call, or nullptr
+    Unique<ScriptReload> Take() {
+        return Unique<ScriptReload>(pending_.exchange(nullptr));
+    }
 
-    if (!file.is_open()) {
-        std::ofstream ofile(filename);
-        ofile << "# this is comment" << std::endl
-              << "# commands:" << std::endl
-              << "#    right <value>: goto right <value> turn" << std::endl
-              << "#    left <value>:  goto left <value> turn" << std::endl
-              << "#    up <value>:    goto up <value> turn" << std::endl
-              << "#    down <value>:  goto down <value> turn" << std::endl
-              << "#    rest <value>:  rest <value> turn" << std::endl
-              << std::endl
-              << "# this is an example:" << std::endl
-              << std::endl
-              << "right 30" << std::endl
-              << "left 30" << std::endl;
-        std::cout << "No robocmd.txt! Please look ./robocmd.txt to program your own logic." << std::endl;
-        exit(1);
-    } else {
-        while (!file.eof()) {
-            file.getline(buf, sizeof(buf));
-            auto cmd = ParserCmd(buf);
-            if (cmd.type != INVALID)
-                result.push_back(ParserCmd(buf));
+private:
+    std::thread thread_;
+    std::atomic<ScriptReload*> pending_{nullptr};
+    std::string path_;
+    std::string name_;
+    int inotify_ = -1;
+    int wake_[2] = {-1, -1};
+
+#ifdef __linux__
+    void watch() {
+        alignas(inotify_event) char buf[4096];
+        pollfd fds[2] = {{inotify_, POLLIN, 0}, {wake_[0], POLLIN, 0}};
+        while (true) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            if (fds[1].revents)
+                return;
+            ssize_t len = read(inotify_, buf, sizeof(buf));
+            bool changed = false;
+            for (char* p = buf; p < buf + std::max<ssize_t>(len, 0);) {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                if (event->len > 0 && name_ == event->name)
+                    changed = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+            if (changed)
+                delete pending_.exchange(load());   // an older one not taken yet is dropped
         }
     }
-
-    if (result.empty()) {
-        std::cout << "no command in robocmd.txt" << std::endl;
-        ShouldExit = true;
+#endif
+
+    ScriptReload* load() {
+        auto reload = new ScriptReload;
+        std::string error;
+        if (!LoadScript(path_, reload->program, error))
+            reload->message = name_ + ":" + error;
+        else if (reload->program.ops.empty())
+            reload->message = "no command in " + name_;
+        else
+            reload->ok = true;
+        if (reload->ok)
+            reload->message = name_ + " reloaded";
+        return reload;
     }
+};
 
-    return result;
-}
+ScriptWatcher Watcher;
+std::string StatusNote;     // shown after the turns, the result of the last reload
 
-void DebugPrintCmd(const Cmd& cmd) {
-    switch (cmd.type) {
-        case MOVE_LEFT:
-            std::cout << "move left " << cmd.move.num << std::endl;
-            break;
-        case MOVE_RIGHT:
-            std::cout << "move right" << cmd.move.num << std::endl;
-            break;
-        case MOVE_UP:
-            std::cout << "move up" << cmd.move.num << std::endl;
-            break;
-        case MOVE_DOWN:
-            std::cout << "move down" << cmd.move.num << std::endl;
-            break;
-        case REST:
-            std::cout << "rest" << cmd.rest.num << std::endl;
-            break;
-        case EXIT_GAME:
-            std::cout << "exit game" << std::endl;
-            break;
-        default:
-            std::cout << "invalid command" << std::endl;
-    }
-}
+/*************************************************
+ * trace: every turn of a game, for --replay
+ ************************************************/
 
-void DealCmd(Cmd& cmd) {
-    switch (cmd.type) {
-        case MOVE_RIGHT:
-            player.pos.x ++;
-            cmd.move.num --;
-            if (cmd.move.num == 0)
-                NextCmd = true;
-            break;
-        case MOVE_LEFT:
-            player.pos.x --; 
-            cmd.move.num --;
-            if (cmd.move.num == 0)
-                NextCmd = true;
-            break;
-        case MOVE_UP:
-            player.pos.y --; 
-            cmd.move.num --;
-            if (cmd.move.num == 0)
-                NextCmd = true;
-            break;
-        case MOVE_DOWN:
-            player.pos.y ++; 
-            cmd.move.num --;
-            if (cmd.move.num == 0)
-                NextCmd = true;
-            break;
-        case REST:
-            cmd.rest.num --;
-            if (cmd.move.num == 0)
-                NextCmd = true;
-            break;
-        case EXIT_GAME:
-            ShouldExit = true;
-            break;
+/*
+file format(little endian):
+    "RGTR", u8 version, u64 seed, u16 width, u16 height, u16 keyframe interval, then records:
+    keyframe: 0x80, varint turn, varint x, varint y of the robot,
+              4 x (varint count, count x (varint x, varint y)) bullets by direction
+    turn:     u8 move | spawns << 3, move is 0 or 1 + the direction of the robot's step,
+              spawns < 15, or 15 and a varint of spawns - 15,
+              spawns x varint(y for left/right, x for up/down << 2 | direction)
+    end:      0x81, varint turns
+a keyframe is the state before its turn, the turns are deltas to it.
+*/
+
+constexpr unsigned char TraceMagic[4] = {'R', 'G', 'T', 'R'};
+constexpr unsigned char TraceVersion = 1;
+constexpr unsigned char TraceKeyframe = 0x80;
+constexpr unsigned char TraceEnd = 0x81;
+
+// the game thread only appends bytes to a buffer, a thread writes the full ones to the file
+// and hands them back empty, so a flush every turn allocates nothing once both have a few
+class TraceRecorder {
+public:
+    static constexpr int KeyframeInterval = 256;
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    ~TraceRecorder() { Close(-1); }
+
+    bool Open(const std::string& filename, uint64_t seed, const Size& size) {
+        file_ = std::fopen(filename.c_str(), "wb");
+        if (!file_)
+            return false;
+        size_ = size;
+        buffer_.reserve(ChunkSize);
+        buffer_.insert(buffer_.end(), TraceMagic, TraceMagic + 4);
+        buffer_.push_back(TraceVersion);
+        putFixed(seed, 8);
+        putFixed(size.w, 2);
+        putFixed(size.h, 2);
+        putFixed(KeyframeInterval, 2);
+        thread_ = std::thread([this]() { drain(); });
+        return true;
     }
-    if (player.pos.x > surface->GetSize().w - 1)
-        player.pos.x = 0;
-    if (player.pos.y > surface->GetSize().h - 1)
-        player.pos.y = 0;
-    if (player.pos.x < 0)
-        player.pos.x = surface->GetSize().w - 1;
-    if (player.pos.y < 0)
-        player.pos.y = surface->GetSize().h - 1;
-}
 
-void GameLoop() {
-    int cmd_idx = 0;
-    std::vector<Cmd> cmds = CmdList;
-    int bulletGenCondition = 30;
+    // before the turn changes anything
+    void BeginTurn(int turn) {
+        if (turn % KeyframeInterval != 0)
+            return;
+        buffer_.push_back(TraceKeyframe);
+        putVarint(turn);
+        putVarint(player.pos.x);
+        putVarint(player.pos.y);
+        for (int d = 0; d < 4; d++) {
+            const BulletGroup& g = BulCollection.Group(d);
+            putVarint(g.Size());
+            for (int i = 0; i < g.Size(); i++) {
+                putVarint(g.x[i]);
+                putVarint(g.y[i]);
+            }
+        }
+        // a game ended by CTRL-C loses one interval at most
+        Flush();
+    }
 
-    while (!ShouldExit) {
-        ClearScreen();
-        surface->Clear();
-        surface->DrawBox({0, 0, surface->GetSize().w - 1, surface->GetSize().h - 1}, WallBox);
-        if (TurnCount > 20 && TurnCount <= 40) {
-            bulletGenCondition = 40;
+    void EndTurn(const Point& from, const Point& to, const Bullet* spawns, int count) {
+        buffer_.push_back(moveCode(from, to) | std::min(count, 15) << 3);
+        if (count >= 15)
+            putVarint(count - 15);
+        for (int i = 0; i < count; i++) {
+            bool horizontal = spawns[i].direction == Bullet::LEFT || spawns[i].direction == Bullet::RIGHT;
+            putVarint(uint64_t(horizontal ? spawns[i].pos.y : spawns[i].pos.x) << 2 | spawns[i].direction);
         }
-        if (TurnCount > 40 && TurnCount <= 60) {
-            bulletGenCondition = 50;
+        if (buffer_.size() >= ChunkSize)
+            Flush();
+    }
+
+    // hands the buffer to the writer thread and goes on in one it has written
+    void Flush() {
+        std::vector<uint8_t> next;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            chunks_.push_back(std::move(buffer_));
+            if (!free_.empty()) {
+                next = std::move(free_.back());
+                free_.pop_back();
+            }
         }
-        if (TurnCount > 60 && TurnCount <= 80) {
-            bulletGenCondition = 60;
+        ready_.notify_one();
+        if (next.capacity() == 0)
+            next.reserve(ChunkSize);
+        buffer_ = std::move(next);
+    }
+
+    // turns < 0 leaves the trace without an end, like a killed game
+    void Close(int turns) {
+        if (!file_)
+            return;
+        if (turns >= 0) {
+            buffer_.push_back(TraceEnd);
+            putVarint(turns);
         }
-        if (TurnCount > 80 && TurnCount <= 100) {
-            bulletGenCondition = 70;
+        Flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closing_ = true;
         }
-        if (TurnCount > 100 && TurnCount <= 120) {
-            bulletGenCondition = 80;
+        ready_.notify_one();
+        thread_.join();
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+private:
+    FILE* file_ = nullptr;
+    Size size_ = {0, 0};
+    std::vector<uint8_t> buffer_;
+    std::vector<std::vector<uint8_t>> chunks_;
+    std::vector<std::vector<uint8_t>> free_;   // written buffers, cleared for the game thread
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool closing_ = false;
+
+    void putFixed(uint64_t v, int bytes) {
+        for (int i = 0; i < bytes; i++)
+            buffer_.push_back((v >> (8 * i)) & 0xff);
+    }
+
+    void putVarint(uint64_t v) {
+        while (v >= 0x80) {
+            buffer_.push_back((v & 0x7f) | 0x80);
+            v >>= 7;
         }
-        if (TurnCount > 120 && TurnCount <= 140) {
-            bulletGenCondition = 90;
+        buffer_.push_back(v);
+    }
+
+    // the robot moves one cell and wraps at the border
+    int moveCode(const Point& from, const Point& to) const {
+        if (from.x == to.x && from.y == to.y)
+            return 0;
+        if (from.y == to.y)
+            return 1 + (to.x == (from.x + 1) % size_.w ? Bullet::RIGHT : Bullet::LEFT);
+        return 1 + (to.y == (from.y + 1) % size_.h ? Bullet::DOWN : Bullet::UP);
+    }
+
+    void drain() {
+        std::vector<std::vector<uint8_t>> chunks;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            ready_.wait(lock, [this]() { return closing_ || !chunks_.empty(); });
+            chunks.swap(chunks_);
+            lock.unlock();
+            for (auto& c : chunks)
+                std::fwrite(c.data(), 1, c.size(), file_);
+            std::fflush(file_);
+            lock.lock();
+            for (auto& c : chunks) {
+                c.clear();
+                free_.push_back(std::move(c));
+            }
+            chunks.clear();
+            if (closing_ && chunks_.empty())
+                return;
         }
-        if (RandInt(0, 100) < bulletGenCondition) {
-            BulCollection.GenNewBullet();
+    }
+};
+
+thread_local TraceRecorder* Recorder = nullptr;   // set when the game on this thread is recorded
+
+/***********************************************************
+ * stats: what a turn costs, in counters and histograms
+ **********************************************************/
+
+// log-linear buckets as HdrHistogram keeps them: the values under 32 each have one, every
+// power of two above is cut into 32, so a value is known to 1/32 of itself in 8KB
+class Histogram {
+public:
+    void Record(int64_t value) {
+        value = std::clamp<int64_t>(value, 0, MaxValue);
+        counts_[index(value)] ++;
+        count_ ++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+
+    void Merge(const Histogram& other) {
+        for (int i = 0; i < Buckets; i++)
+            counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    int64_t Count() const { return count_; }
+    int64_t Max() const { return max_; }
+    double Mean() const { return count_ ? double(sum_) / count_ : 0; }
+
+    // the value p percent of the records are at or under, the top of its bucket
+    int64_t Percentile(double p) const {
+        int64_t target = std::max<int64_t>(1, int64_t(std::ceil(p / 100 * count_))), seen = 0;
+        for (int i = 0; i < Buckets && count_ > 0; i++) {
+            seen += counts_[i];
+            if (seen >= target)
+                return std::min(top(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    static constexpr int SubBits = 5;
+    static constexpr int MaxBits = 36;      // 2^36 ns is more than a minute
+    static constexpr int64_t MaxValue = (int64_t(1) << MaxBits) - 1;
+    static constexpr int Buckets = (MaxBits - SubBits + 1) << SubBits;
+
+    uint64_t counts_[Buckets] = {};
+    int64_t count_ = 0;
+    int64_t sum_ = 0;
+    int64_t max_ = 0;
+
+    static int index(int64_t value) {
+        if (value < (1 << SubBits))
+            return int(value);
+        int high = 63 - __builtin_clzll(value);
+        return ((high - SubBits + 1) << SubBits) + int((value >> (high - SubBits)) & ((1 << SubBits) - 1));
+    }
+
+    // the biggest value of bucket i
+    static int64_t top(int i) {
+        int group = i >> SubBits, sub = i & ((1 << SubBits) - 1);
+        if (group == 0)
+            return i;
+        return (int64_t((1 << SubBits) + sub + 1) << (group - 1)) - 1;
+    }
+};
+
+enum StatsPhase {
+    PHASE_SPAWN,
+    PHASE_UPDATE,   // moving the bullets, and drawing them when shown
+    PHASE_SCRIPT,   // the commands of the turn
+    PHASE_RENDER,
+    PHASE_RECORD,   // the trace
+    PHASE_TURN,     // all of the turn
+    PHASE_COUNT
+};
+
+constexpr const char* PhaseName[PHASE_COUNT] = {"spawn", "update", "script", "render", "record", "turn"};
+
+// the game thread adds a turn's times up in an array and records them once at the end of the
+// turn, the histograms of a window of turns are written to the stream and then added to the total
+class TurnStats {
+public:
+    // ns of the steady clock
+    static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // every `every` turns a line into filename
+    bool Stream(const std::string& filename, int every) {
+        stream_.open(filename);
+        if (!stream_.is_open())
+            return false;
+        every_ = every;
+        stream_ << "# turn bullets capacity";
+        for (int p = 0; p < PHASE_COUNT; p++)
+            stream_ << " " << PhaseName[p] << "_p50 " << PhaseName[p] << "_p99 " << PhaseName[p] << "_max";
+        stream_ << "   (the last " << every << " turns, times in ns)" << std::endl;
+        return true;
+    }
+
+    // returns the mark for the first Lap()
+    int64_t BeginTurn() {
+        begin_ = Now();
+        return begin_;
+    }
+
+    // the time since mark goes to phase, returns the mark for the next one
+    int64_t Lap(StatsPhase phase, int64_t mark) {
+        int64_t now = Now();
+        spent_[phase] += now - mark;
+        used_ |= 1 << phase;
+        return now;
+    }
+
+    void EndTurn(int turn, int bullets, size_t capacity, int spawned, int ops) {
+        spent_[PHASE_TURN] = Now() - begin_;
+        used_ |= 1 << PHASE_TURN;
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (used_ >> p & 1)
+                window_.phases[p].Record(spent_[p]);
+            spent_[p] = 0;
+        }
+        used_ = 0;
+        window_.bullets.Record(bullets);
+        window_.ops.Record(ops);
+        spawned_ += spawned;
+        grown_ += capacity > capacity_;     // a new game starts from an empty collection again
+        capacity_ = capacity;
+        maxCapacity_ = std::max(maxCapacity_, capacity);
+        if (stream_.is_open() && ++windowTurns_ >= every_)
+            flush(turn);
+    }
+
+    // the turns not in the total yet are added, call it when the game is over
+    void Finish() {
+        flush(-1);
+        if (stream_.is_open())
+            stream_.close();
+    }
+
+    void Merge(const TurnStats& other) {
+        total_.Merge(other.total_);
+        spawned_ += other.spawned_;
+        grown_ += other.grown_;
+        maxCapacity_ = std::max(maxCapacity_, other.maxCapacity_);
+    }
+
+    void Dump(std::ostream& out) const {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-16s %10s %10s %10s %10s %10s %10s %10s",
+                      "a turn costs", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+        out << line << std::endl;
+        auto row = [&](const char* name, const Histogram& h, const char* unit) {
+            std::snprintf(line, sizeof(line), "%-16s %10lld %10.1f %10lld %10lld %10lld %10lld %10lld%s",
+                          name, (long long)h.Count(), h.Mean(), (long long)h.Percentile(50),
+                          (long long)h.Percentile(90), (long long)h.Percentile(99),
+                          (long long)h.Percentile(99.9), (long long)h.Max(), unit);
+            out << line << std::endl;
+        };
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (total_.phases[p].Count() > 0)
+                row(PhaseName[p], total_.phases[p], " ns");
+        }
+        row("live bullets", total_.bullets, "");
+        row("script ops", total_.ops, "");
+        out << spawned_ << " bullets spawned, the bullet arrays grew in " << grown_
+            << " turns, to " << maxCapacity_ << " bullets" << std::endl;
+    }
+
+private:
+    struct Window {
+        Histogram phases[PHASE_COUNT];
+        Histogram bullets;
+        Histogram ops;
+
+        void Merge(const Window& other) {
+            for (int p = 0; p < PHASE_COUNT; p++)
+                phases[p].Merge(other.phases[p]);
+            bullets.Merge(other.bullets);
+            ops.Merge(other.ops);
+        }
+    };
+
+    Window window_;
+    Window total_;
+    int64_t begin_ = 0;
+    int64_t spent_[PHASE_COUNT] = {};
+    unsigned used_ = 0;
+    int64_t spawned_ = 0;
+    int64_t grown_ = 0;
+    size_t capacity_ = 0;
+    size_t maxCapacity_ = 0;
+    std::ofstream stream_;
+    int every_ = 100;
+    int windowTurns_ = 0;
+
+    void flush(int turn) {
+        if (stream_.is_open() && windowTurns_ > 0 && turn >= 0) {
+            stream_ << turn << " " << window_.bullets.Max() << " " << capacity_;
+            for (auto& h : window_.phases)
+                stream_ << " " << h.Percentile(50) << " " << h.Percentile(99) << " " << h.Max();
+            stream_ << "\n";
+        }
+        total_.Merge(window_);
+        window_ = Window();
+        windowTurns_ = 0;
+    }
+};
+
+thread_local TurnStats* Stats = nullptr;    // set when the game on this thread is measured
+
+/******************************************************
+ * work pool: each worker has a deque, idle ones steal
+ *****************************************************/
+
+class WorkPool {
+public:
+    explicit WorkPool(int threads) {
+        for (int i = 0; i < threads; i++)
+            queues_.emplace_back(new Queue);
+        for (int i = 0; i < threads; i++)
+            threads_.emplace_back([this, i]() { work(i); });
+    }
+
+    ~WorkPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : threads_)
+            t.join();
+    }
+
+    int Size() const { return threads_.size(); }
+
+    // runs task(0) ... task(count - 1) on the workers, returns when all are done
+    void Run(int count, const std::function<void(int)>& task) {
+        if (count <= 0)
+            return;
+        std::unique_lock<std::mutex> lock(mutex_);
+        task_ = &task;
+        left_ = count;
+        // neighbour tasks start on the same worker, who finishes early steals the rest
+        for (int i = 0; i < count; i++) {
+            Queue& q = *queues_[int64_t(i) * queues_.size() / count];
+            std::lock_guard<std::mutex> qlock(q.mutex);
+            q.tasks.push_back(i);
+        }
+        round_ ++;
+        wake_.notify_all();
+        done_.wait(lock, [this]() { return left_ == 0; });
+        task_ = nullptr;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    std::vector<Unique<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    const std::function<void(int)>* task_ = nullptr;
+    int left_ = 0;
+    int round_ = 0;
+    bool stop_ = false;
+
+    // own tasks from the back, stolen ones from the front
+    bool pop(int self, int& task) {
+        int n = queues_.size();
+        for (int k = 0; k < n; k++) {
+            Queue& q = *queues_[(self + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty())
+                continue;
+            if (k == 0) {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+            } else {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void work(int self) {
+        int seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]() { return stop_ || round_ != seen; });
+                if (stop_)
+                    return;
+                seen = round_;
+            }
+            int task;
+            while (pop(self, task)) {
+                const std::function<void(int)>* fn;
+                {
+                    // the task may be of the next Run already
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    fn = task_;
+                }
+                (*fn)(task);
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--left_ == 0)
+                    done_.notify_one();
+            }
+        }
+    }
+};
+
+/***************************************************
+ * arena: many robots against the same bullets
+ **************************************************/
+
+// the robots still alive are packed at the front of every array, a robot hit is
+// swapped with the last live one, so the loops only go over live robots
+struct ArenaRobots {
+    std::vector<int> id;    // which script
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> fromX;
+    std::vector<int> fromY;
+    std::vector<char> quit;
+    std::vector<ScriptRunner> runners;
+    int live = 0;
+
+    void Add(int robot, const Program* program, const Point& pos) {
+        id.push_back(robot);
+        x.push_back(pos.x);
+        y.push_back(pos.y);
+        fromX.push_back(pos.x);
+        fromY.push_back(pos.y);
+        quit.push_back(0);
+        runners.emplace_back();
+        runners.back().Reset(program);
+        live ++;
+    }
+
+    void Remove(int i) {
+        int last = --live;
+        std::swap(id[i], id[last]);
+        std::swap(x[i], x[last]);
+        std::swap(y[i], y[last]);
+        std::swap(fromX[i], fromX[last]);
+        std::swap(fromY[i], fromY[last]);
+        std::swap(quit[i], quit[last]);
+        std::swap(runners[i], runners[last]);
+    }
+};
+
+int PlayArena(const std::vector<Program>& programs, uint64_t seed, int maxTurns, std::vector<int>& turns);
+
+/*******************************************
+ * evolve: genetic search for command loops
+ ******************************************/
+
+constexpr int MaxGenes = 24;        // commands of a script
+constexpr int MaxGeneTurns = 12;    // turns of one command
+constexpr int EliteCount = 4;
+
+struct Candidate {
+    Program program;
+    double fitness = 0;     // mean turns survived
+    bool scored = false;
+};
+
+/****************
+ * main function
+ ***************/
+
+int main(int argc, char** argv) {
+    GameSeed = std::random_device{}();
+    bool headless = false, bench = false, evolve = false, benchBullets = false, benchParser = false,
+         benchAuto = false, stats = false, test = false;
+    int seeds = 0,
+        threads = std::max(1u, std::thread::hardware_concurrency()),
+        maxTurns = 0,
+        generations = 30,
+        population = 64,
+        bullets = 100000,
+        lines = 2000000;
+    std::string out = "robocmd.txt", recordFile, replayFile, scheduleFile, statsFile;
+    std::vector<std::string> arena;
+    bool play = false;
+    int turn = -1, delay = 100, statsEvery = 100;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc)
+            GameSeed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg == "--seeds" && i + 1 < argc)
+            seeds = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--max-turns" && i + 1 < argc)
+            maxTurns = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--bench-script")
+            bench = true;
+        else if (arg == "--evolve")
+            evolve = true;
+        else if (arg == "--generations" && i + 1 < argc)
+            generations = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--population" && i + 1 < argc)
+            population = std::max(EliteCount + 1, std::atoi(argv[++i]));
+        else if (arg == "--out" && i + 1 < argc)
+            out = argv[++i];
+        else if (arg == "--bench-bullets")
+            benchBullets = true;
+        else if (arg == "--bullets" && i + 1 < argc)
+            bullets = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--record" && i + 1 < argc)
+            recordFile = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayFile = argv[++i];
+        else if (arg == "--turn" && i + 1 < argc)
+            turn = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--play")
+            play = true;
+        else if (arg == "--delay" && i + 1 < argc)
+            delay = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--arena") {
+            while (i + 1 < argc && std::string_view(argv[i + 1]).substr(0, 2) != "--")
+                arena.push_back(argv[++i]);
+        }
+        else if (arg == "--bench-parser")
+            benchParser = true;
+        else if (arg == "--bench-auto")
+            benchAuto = true;
+        else if (arg == "--size" && i + 1 < argc) {
+            int w = 0, h = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w < 8 || h < 8 ||
+                w > MaxFieldSide || h > MaxFieldSide) {
+                std::cout << "--size takes <w>x<h>, from 8x8 to " << MaxFieldSide << "x" << MaxFieldSide << std::endl;
+                return 1;
+            }
+            FieldSize = {w, h};
+        }
+        else if (arg == "--schedule" && i + 1 < argc)
+            scheduleFile = argv[++i];
+        else if (arg == "--stats")
+            stats = true;
+        else if (arg == "--stats-out" && i + 1 < argc)
+            statsFile = argv[++i];
+        else if (arg == "--stats-every" && i + 1 < argc)
+            statsEvery = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--lines" && i + 1 < argc)
+            lines = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--test")
+            test = true;
+    }
+    if (test) {
+        TestCmdParser();
+        TestCompileScript();
+        std::cout << "tests passed" << std::endl;
+        return 0;
+    }
+    // before any game, the other threads take both when their first game starts
+    surface.reset(new Surface(FieldSize));
+    if (!scheduleFile.empty()) {
+        std::string error;
+        if (!LoadSchedule(scheduleFile, Schedule, error)) {
+            std::cout << scheduleFile << ":" << error << std::endl;
+            return 1;
+        }
+    } else {
+        Schedule = ScaleSchedule(DefaultSchedule, FieldSize);
+    }
+    if (bench) {
+        BenchScript(GameSeed);
+        return 0;
+    }
+    if (!replayFile.empty())
+        return ReplayTrace(replayFile, turn, play, delay);
+    if (!arena.empty()) {
+        RunArena(arena, GameSeed, seeds ? seeds : 1, threads, maxTurns ? maxTurns : 1000000);
+        return 0;
+    }
+    if (benchParser) {
+        BenchParser(lines);
+        return 0;
+    }
+    if (benchBullets) {
+        BenchBullets(GameSeed, bullets);
+        return 0;
+    }
+    if (benchAuto) {
+        BenchAutopilot(GameSeed);
+        return 0;
+    }
+    if (evolve) {
+        EvolveScripts(GameSeed, seeds ? seeds : 16, threads, maxTurns ? maxTurns : 20000,
+                      generations, population, out);
+        return 0;
+    }
+    GameRandom.Seed(GameSeed);
+    Init();
+    TraceRecorder recorder;
+    if (!recordFile.empty()) {
+        if (headless && seeds > 1) {
+            std::cout << "--record plays one seed" << std::endl;
+            return 1;
+        }
+        if (!recorder.Open(recordFile, GameSeed, surface->GetSize())) {
+            std::cout << "can't write " << recordFile << std::endl;
+            return 1;
+        }
+        Recorder = &recorder;
+    }
+    // always for the game on the screen, it sleeps most of a turn anyway
+    TurnStats turnStats;
+    if (!statsFile.empty()) {
+        if (headless && seeds > 1) {
+            std::cout << "--stats-out plays one seed" << std::endl;
+            return 1;
+        }
+        if (!turnStats.Stream(statsFile, statsEvery)) {
+            std::cout << "can't write " << statsFile << std::endl;
+            return 1;
+        }
+        stats = true;
+    }
+    if (headless) {
+        if (Script.ops.empty()) {
+            std::cout << "no command in robocmd.txt" << std::endl;
+            return 1;
+        }
+        if (Recorder) {
+            Stats = stats ? &turnStats : nullptr;
+            int turns = RunHeadless(Script, GameSeed, maxTurns ? maxTurns : 1000000);
+            recorder.Close(turns);
+            std::cout << "seed " << GameSeed << ": survived " << turns << " turns, recorded to " << recordFile << std::endl;
+        } else {
+            EvaluateScript(GameSeed, seeds ? seeds : 1, threads, maxTurns ? maxTurns : 1000000,
+                           stats ? &turnStats : nullptr);
+        }
+        if (stats) {
+            turnStats.Finish();
+            turnStats.Dump(std::cout);
+        }
+        return 0;
+    }
+    Stats = &turnStats;
+    GameLoop();
+    recorder.Close(TurnCount);
+    turnStats.Finish();
+    turnStats.Dump(std::cout);
+    return 0;
+}
+
+/****************************
+ * function implementations
+****************************/
+
+int RandInt(int low, int high) {
+    return GameRandom.Int(low, high);
+}
+
+void ClearScreen() {
+    const char seq[] = "\x1b[2J\x1b[H";
+    std::cout.flush();
+    WriteAll(seq, sizeof(seq) - 1);
+    renderer.Invalidate();
+}
+
+void UpdateScreen(Surface* surface, const std::string& status) {
+    renderer.Present(surface, status);
+}
+
+// where the view is, when the field is bigger than the screen
+std::string ViewNote() {
+    const Rect& view = surface->GetView();
+    const Size& size = surface->GetSize();
+    if (view.size.w == size.w && view.size.h == size.h)
+        return "";
+    return "  [view " + std::to_string(view.pos.x) + "," + std::to_string(view.pos.y) + " of " +
+           std::to_string(size.w) + "x" + std::to_string(size.h) + "]";
+}
+
+void WriteAll(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+void Init() {
+    player.pos.x = surface->GetSize().w / 2;
+    player.pos.y = surface->GetSize().h / 2;
+    Script = ReadScriptFromFile("robocmd.txt");
+    Runner.Reset(&Script);
+}
+
+// words are separated by spaces and tabs, they point into line; at most max words
+int SplitWords(std::string_view line, std::string_view* words, int max) {
+    auto blank = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+    int count = 0;
+    size_t i = 0, n = line.size();
+    while (count < max) {
+        while (i < n && blank(line[i]))
+            i ++;
+        if (i == n)
+            break;
+        size_t begin = i;
+        while (i < n && !blank(line[i]))
+            i ++;
+        words[count++] = line.substr(begin, i - begin);
+    }
+    return count;
+}
+
+// the whole of s must be the number
+bool ParseInt(std::string_view s, int& value) {
+    auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+    return result.ec == std::errc() && result.ptr == s.data() + s.size();
+}
+
+Cmd ParserCmd(const std::string& s) {
+    std::string_view words[3];
+    return ParserCmd(words, SplitWords(s, words, 3));
+}
+
+Cmd ParserCmd(const std::string_view* words, int count) {
+    Cmd cmd;
+    if (count == 2) {
+        CmdType type = INVALID;
+        if (words[0] == "right") {
+            type = MOVE_RIGHT;
+        } else if (words[0] == "left") {
+            type = MOVE_LEFT;
+        } else if (words[0] == "up") {
+            type = MOVE_UP;
+        } else if (words[0] == "down") {
+            type = MOVE_DOWN;
+        } else if (words[0] == "rest") {
+            type = REST;
+        } else if (words[0] == "auto") {
+            type = AUTO;
+        }
+        if (type != INVALID && ParseInt(words[1], cmd.move.num))
+            cmd.type = type;
+    }
+    if (count == 1) {
+        if (words[0] == "exit")
+            cmd.type = EXIT_GAME;
+    }
+    return cmd;
+}
+
+Program ReadScriptFromFile(const std::string& filename) {
+    Program result;
+
+    if (access(filename.c_str(), F_OK) != 0) {
+        std::ofstream ofile(filename);
+        ofile << "# this is comment" << std::endl
+              << "# commands:" << std::endl
+              << "#    right <value>: goto right <value> turn" << std::endl
+              << "#    left <value>:  goto left <value> turn" << std::endl
+              << "#    up <value>:    goto up <value> turn" << std::endl
+              << "#    down <value>:  goto down <value> turn" << std::endl
+              << "#    rest <value>:  rest <value> turn" << std::endl
+              << "#    auto <value>:  the autopilot leads the robot <value> turn" << std::endl
+              << "#    exit:          end the game" << std::endl
+              << "# these take no turn:" << std::endl
+              << "#    repeat <n> ... end:          do the commands between n times" << std::endl
+              << "#    label <name>, jump <name>:   go on from the label" << std::endl
+              << "#    if [not] near <d> ... [else ...] end:" << std::endl
+              << "#        when a bullet is within <d> cells" << std::endl
+              << "#    if [not] bullet <left|right|up|down> <d> ... [else ...] end:" << std::endl
+              << "#        when a bullet <d> cells away at that side flies to you" << std::endl
+              << std::endl
+              << "# this is an example:" << std::endl
+              << std::endl
+              << "right 30" << std::endl
+              << "left 30" << std::endl;
+        std::cout << "No robocmd.txt! Please look ./robocmd.txt to program your own logic." << std::endl;
+        exit(1);
+    } else {
+        std::string error;
+        if (!LoadScript(filename, result, error)) {
+            std::cout << filename << ":" << error << std::endl;
+            exit(1);
+        }
+    }
+
+    if (result.ops.empty()) {
+        std::cout << "no command in robocmd.txt" << std::endl;
+        ShouldExit = true;
+    }
+
+    return result;
+}
+
+// the file is mapped and compiled where it lies, no line is copied
+bool LoadScript(const std::string& filename, Program& program, std::string& error) {
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = " can't open it";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        error = " can't stat it";
+        return false;
+    }
+    size_t size = st.st_size;
+    if (size == 0) {
+        close(fd);
+        return CompileScript({}, program, error);
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        error = " can't map it";
+        return false;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    bool ok = CompileScript(std::string_view(static_cast<const char*>(data), size), program, error);
+    munmap(data, size);
+    return ok;
+}
+
+bool CompileScript(std::string_view source, Program& program, std::string& error) {
+    struct Block {
+        enum { REPEAT, IF, ELSE } kind;
+        int op;     // the op whose target is patched at end
+        int line;
+    };
+    struct Fixup {
+        std::string_view label;
+        int op;
+        int line;
+    };
+    // "if not bullet left 3" is the longest, one more word means a wrong line
+    constexpr int MaxWords = 6;
+
+    std::vector<Block> blocks;
+    std::vector<Fixup> fixups;
+    std::unordered_map<std::string_view, int> labels;
+    std::string_view line;
+    std::string_view words[MaxWords];
+    int count = 0;
+    auto text = [&]() {
+        std::string_view rest(words[0].data(), line.data() + line.size() - words[0].data());
+        return std::string(rest.substr(0, rest.find_last_not_of(" \t\r") + 1));
+    };
+    auto fail = [&](int line, const std::string& msg) {
+        error = std::to_string(line) + ": " + msg;
+        return false;
+    };
+    auto parseDir = [](std::string_view s) {
+        if (s == "left") return int(Bullet::LEFT);
+        if (s == "right") return int(Bullet::RIGHT);
+        if (s == "up") return int(Bullet::UP);
+        if (s == "down") return int(Bullet::DOWN);
+        return -1;
+    };
+
+    program = Program();
+    std::vector<Op>& ops = program.ops;
+    // a guess from the size, about 8 characters a line, the vector grows past it
+    ops.reserve(source.size() / 8 + 1);
+    const char* p = source.data();
+    const char* end = p + source.size();
+    for (int lineno = 1; p < end; lineno++) {
+        auto eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        line = std::string_view(p, eol - p);
+        p = eol + 1;
+
+        line = line.substr(0, line.find('#'));
+        count = SplitWords(line, words, MaxWords);
+        if (count == 0)
+            continue;
+        if (count == MaxWords)
+            return fail(lineno, "too many words: " + text());
+
+        Cmd cmd = ParserCmd(words, count);
+        Op op = {};
+        switch (cmd.type) {
+            case MOVE_RIGHT: op.code = OP_MOVE; op.dir = Bullet::RIGHT; op.n = cmd.move.num; break;
+            case MOVE_LEFT:  op.code = OP_MOVE; op.dir = Bullet::LEFT; op.n = cmd.move.num; break;
+            case MOVE_UP:    op.code = OP_MOVE; op.dir = Bullet::UP; op.n = cmd.move.num; break;
+            case MOVE_DOWN:  op.code = OP_MOVE; op.dir = Bullet::DOWN; op.n = cmd.move.num; break;
+            case REST:       op.code = OP_REST; op.n = cmd.rest.num; break;
+            case AUTO:       op.code = OP_AUTO; op.n = cmd.autopilot.num; break;
+            case EXIT_GAME:  op.code = OP_EXIT; break;
+            default: break;
         }
-        BulCollection.Update();
+        if (cmd.type != INVALID) {
+            if (op.code != OP_EXIT && op.n < 1)
+                return fail(lineno, "bad number: " + text());
+            ops.push_back(op);
+            continue;
+        }
+
+        if (words[0] == "label" && count == 2) {
+            if (!labels.emplace(words[1], ops.size()).second)
+                return fail(lineno, "label " + std::string(words[1]) + " is defined twice");
+        } else if (words[0] == "jump" && count == 2) {
+            op.code = OP_JUMP;
+            fixups.push_back({words[1], int(ops.size()), lineno});
+            ops.push_back(op);
+        } else if (words[0] == "repeat" && count == 2) {
+            op.code = OP_REPEAT;
+            op.counter = program.counters++;
+            if (!ParseInt(words[1], op.n))
+                return fail(lineno, "bad number: " + text());
+            blocks.push_back({Block::REPEAT, int(ops.size()), lineno});
+            ops.push_back(op);
+        } else if (words[0] == "if") {
+            int i = 1;
+            if (i < count && words[i] == "not") {
+                op.negate = true;
+                i++;
+            }
+            if (count == i + 2 && words[i] == "near") {
+                op.code = OP_IF_NEAR;
+                if (!ParseInt(words[i + 1], op.n))
+                    return fail(lineno, "bad number: " + text());
+            } else if (count == i + 3 && words[i] == "bullet" && parseDir(words[i + 1]) >= 0) {
+                op.code = OP_IF_BULLET;
+                op.dir = parseDir(words[i + 1]);
+                if (!ParseInt(words[i + 2], op.n))
+                    return fail(lineno, "bad number: " + text());
+            } else {
+                return fail(lineno, "bad condition: " + text());
+            }
+            blocks.push_back({Block::IF, int(ops.size()), lineno});
+            ops.push_back(op);
+        } else if (words[0] == "else" && count == 1) {
+            if (blocks.empty() || blocks.back().kind != Block::IF)
+                return fail(lineno, "else without if");
+            ops[blocks.back().op].target = ops.size() + 1;
+            blocks.back() = {Block::ELSE, int(ops.size()), lineno};
+            op.code = OP_JUMP;
+            ops.push_back(op);
+        } else if (words[0] == "end" && count == 1) {
+            if (blocks.empty())
+                return fail(lineno, "end without repeat or if");
+            Block block = blocks.back();
+            blocks.pop_back();
+            if (block.kind == Block::REPEAT) {
+                op.code = OP_LOOP;
+                op.counter = ops[block.op].counter;
+                op.target = block.op + 1;
+                ops.push_back(op);
+            }
+            ops[block.op].target = ops.size();
+        } else {
+            return fail(lineno, "unknown command: " + text());
+        }
+    }
+
+    if (!blocks.empty())
+        return fail(blocks.back().line, "block is not closed by end");
+    for (auto& f : fixups) {
+        auto label = labels.find(f.label);
+        if (label == labels.end())
+            return fail(f.line, "no label " + std::string(f.label));
+        ops[f.op].target = label->second;
+    }
+    return true;
+}
+
+void DebugPrintCmd(const Cmd& cmd) {
+    switch (cmd.type) {
+        case MOVE_LEFT:
+            std::cout << "move left " << cmd.move.num << std::endl;
+            break;
+        case MOVE_RIGHT:
+            std::cout << "move right" << cmd.move.num << std::endl;
+            break;
+        case MOVE_UP:
+            std::cout << "move up" << cmd.move.num << std::endl;
+            break;
+        case MOVE_DOWN:
+            std::cout << "move down" << cmd.move.num << std::endl;
+            break;
+        case REST:
+            std::cout << "rest" << cmd.rest.num << std::endl;
+            break;
+        case AUTO:
+            std::cout << "auto " << cmd.autopilot.num << std::endl;
+            break;
+        case EXIT_GAME:
+            std::cout << "exit game" << std::endl;
+            break;
+        default:
+            std::cout << "invalid command" << std::endl;
+    }
+}
+
+void MoveRobo(Point& pos, int dir) {
+    switch (dir) {
+        case Bullet::RIGHT:
+            pos.x ++;
+            break;
+        case Bullet::LEFT:
+            pos.x --;
+            break;
+        case Bullet::UP:
+            pos.y --;
+            break;
+        case Bullet::DOWN:
+            pos.y ++;
+            break;
+    }
+    if (pos.x > surface->GetSize().w - 1)
+        pos.x = 0;
+    if (pos.y > surface->GetSize().h - 1)
+        pos.y = 0;
+    if (pos.x < 0)
+        pos.x = surface->GetSize().w - 1;
+    if (pos.y < 0)
+        pos.y = surface->GetSize().h - 1;
+}
+
+void GameLoop() {
+    Watcher.Start("robocmd.txt");
+    ClearScreen();
+    while (!ShouldExit) {
+        if (auto reload = Watcher.Take()) {
+            // a new script starts from its first command, the old one goes on if it failed
+            if (reload->ok) {
+                Script = std::move(reload->program);
+                Runner.Reset(&Script);
+            }
+            StatusNote = "  [" + reload->message + "]";
+        }
+        PlayTurn(true);
+        if (Recorder)
+            Recorder->Flush();  // we sleep anyway, and CTRL-C loses nothing
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    }
+    Watcher.Stop();
+    ClearScreen();
+    std::cout << "Game Over, you survived " << TurnCount << " turns!" << std::endl
+              << "seed " << GameSeed << ", replay it with --seed " << GameSeed << std::endl;
+}
+
+// the percent of the schedule step the turn is in
+int BulletGenCondition(int turn) {
+    auto step = std::upper_bound(Schedule.begin(), Schedule.end(), turn,
+                                 [](int turn, const ScheduleStep& s) { return turn < s.turn; });
+    return step == Schedule.begin() ? 0 : (step - 1)->percent;
+}
+
+// a bullet for every whole 100 percent, and by chance one more for the rest
+int SpawnBullets(int turn, std::vector<Bullet>& spawned) {
+    spawned.clear();
+    for (int percent = BulletGenCondition(turn); percent > 0; percent -= 100) {
+        if (RandInt(0, 100) < percent)
+            spawned.push_back(BulCollection.GenNewBullet());
+    }
+    return spawned.size();
+}
+
+// the built-in schedule on another field: bullets come in from the sides, so as many
+// more as the sides are longer keep the field as crowded
+std::vector<ScheduleStep> ScaleSchedule(const std::vector<ScheduleStep>& schedule, const Size& size) {
+    std::vector<ScheduleStep> scaled = schedule;
+    for (auto& step : scaled)
+        step.percent = int(int64_t(step.percent) * (size.w + size.h) / (DefaultCanvaWidth + DefaultCanvaHeight));
+    return scaled;
+}
+
+// lines of `<turn> <percent>`, the turns going up, # starts a comment
+bool LoadSchedule(const std::string& filename, std::vector<ScheduleStep>& schedule, std::string& error) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        error = "can't open it";
+        return false;
+    }
+    schedule.clear();
+    std::string line;
+    for (int lineno = 1; std::getline(file, line); lineno++) {
+        std::string_view words[3];
+        int count = SplitWords(std::string_view(line).substr(0, line.find('#')), words, 3);
+        if (count == 0)
+            continue;
+        ScheduleStep step;
+        if (count != 2 || !ParseInt(words[0], step.turn) || !ParseInt(words[1], step.percent) ||
+            step.turn < 0 || step.percent < 0) {
+            error = std::to_string(lineno) + ": bad step: " + line;
+            return false;
+        }
+        if (!schedule.empty() && step.turn <= schedule.back().turn) {
+            error = std::to_string(lineno) + ": the turns must go up: " + line;
+            return false;
+        }
+        schedule.push_back(step);
+    }
+    if (schedule.empty()) {
+        error = "no step";
+        return false;
+    }
+    return true;
+}
+
+// the same turn for the screen and the headless mode, draw only decides whether we render it
+void PlayTurn(bool draw) {
+    TurnStats* stats = Stats;
+    int64_t mark = stats ? stats->BeginTurn() : 0;
+    if (Recorder)
+        Recorder->BeginTurn(TurnCount);
+    if (draw) {
+        surface->Follow(player.pos);
+        surface->Clear();
+        surface->DrawBox({0, 0, surface->GetSize().w - 1, surface->GetSize().h - 1}, WallBox);
+        if (stats)
+            mark = stats->Lap(PHASE_RENDER, mark);
+    }
+    static thread_local std::vector<Bullet> spawned;
+    int spawns = SpawnBullets(TurnCount, spawned);
+    if (stats)
+        mark = stats->Lap(PHASE_SPAWN, mark);
+    BulCollection.Update(draw);
+    if (stats)
+        mark = stats->Lap(PHASE_UPDATE, mark);
+    if (draw) {
         player.Draw();
-        UpdateScreen(surface.get());
+        UpdateScreen(surface.get(), std::to_string(TurnCount) + " turns.  To exit, press CTRL-C a long time" + ViewNote() + StatusNote);
+        if (stats)
+            mark = stats->Lap(PHASE_RENDER, mark);
+    }
 
-        if (NextCmd) {
-            cmd_idx ++;
-            NextCmd = false;
+    Point from = player.pos;
+    int ops = Runner.Turn(player.pos, ShouldExit);
+    if (stats)
+        mark = stats->Lap(PHASE_SCRIPT, mark);
+    if (BulCollection.Hit(from, player.pos))
+        ShouldExit = true;
+    if (Recorder) {
+        Recorder->EndTurn(from, player.pos, spawned.data(), spawns);
+        if (stats)
+            mark = stats->Lap(PHASE_RECORD, mark);
+    }
+    if (stats)
+        stats->EndTurn(TurnCount, BulCollection.Count(), BulCollection.Capacity(), spawns, ops);
+    TurnCount ++;
+}
+
+void ResetGame(uint64_t seed, const Program& program) {
+    player.pos.x = surface->GetSize().w / 2;
+    player.pos.y = surface->GetSize().h / 2;
+    BulCollection = BulletCollection();
+    Runner.Reset(&program);
+    ShouldExit = false;
+    TurnCount = 0;
+    GameSeed = seed;
+    GameRandom.Seed(seed);
+}
+
+// play a whole game on this thread, return the turns survived
+int RunHeadless(const Program& program, uint64_t seed, int maxTurns) {
+    ResetGame(seed, program);
+    while (!ShouldExit && TurnCount < maxTurns)
+        PlayTurn(false);
+    return TurnCount;
+}
+
+// stats, when not nullptr, gets the costs of the turns of all the games
+void EvaluateScript(uint64_t seed, int seeds, int threads, int maxTurns, TurnStats* stats) {
+    std::vector<int> turns(seeds);
+    std::atomic<int> next(0);
+    auto begin = std::chrono::steady_clock::now();
+
+    // the first worker measures into stats, the others into their own, added up after
+    std::vector<Unique<TurnStats>> workerStats(std::min(threads, seeds));
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::min(threads, seeds); t++) {
+        if (stats && t > 0)
+            workerStats[t].reset(new TurnStats);
+        TurnStats* mine = t == 0 ? stats : workerStats[t].get();
+        workers.emplace_back([&, mine]() {
+            Stats = mine;
+            int i;
+            while ((i = next++) < seeds)
+                turns[i] = RunHeadless(Script, seed + i, maxTurns);
+            if (mine)
+                mine->Finish();
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    for (auto& s : workerStats) {
+        if (s)
+            stats->Merge(*s);
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (seeds == 1) {
+        std::cout << "seed " << seed << ": survived " << turns[0] << " turns" << std::endl;
+    }
+
+    int64_t total = 0;
+    int capped = 0;
+    for (int t : turns) {
+        total += t;
+        if (t >= maxTurns)
+            capped ++;
+    }
+    std::vector<int> sorted = turns;
+    std::sort(sorted.begin(), sorted.end());
+    std::cout << seeds << " games on seeds " << seed << ".." << seed + seeds - 1
+              << " with " << std::min(threads, seeds) << " threads" << std::endl
+              << "turns: mean " << double(total) / seeds
+              << ", min " << sorted.front()
+              << ", median " << sorted[seeds / 2]
+              << ", max " << sorted.back() << std::endl;
+    if (capped > 0)
+        std::cout << capped << " games reached --max-turns " << maxTurns << std::endl;
+    std::cout << total << " turns in " << elapsed << "s, "
+              << total / std::max(elapsed, 1e-9) << " turns/sec" << std::endl;
+}
+
+// dodges with every kind of op, the moves are short so the sensing runs often
+const char* BenchScriptSource = R"(
+label top
+if bullet left 3
+    up 1
+else
+    if bullet right 3
+        down 1
+    end
+end
+if bullet up 3
+    right 1
+end
+if bullet down 3
+    left 1
+end
+repeat 3
+    if not near 1
+        rest 1
+    else
+        down 1
+    end
+end
+jump top
+)";
+
+void BenchScript(uint64_t seed) {
+    std::string error;
+    if (!CompileScript(BenchScriptSource, Script, error)) {
+        std::cout << "bench script: " << error << std::endl;
+        return;
+    }
+
+    // a game with bullets on the field, the robot may die but the bullets go on
+    ResetGame(seed, Script);
+    for (int i = 0; i < 200; i++)
+        PlayTurn(false);
+
+    const int turns = 2000000;
+    int64_t ops = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < turns; i++)
+        ops += Runner.Turn(player.pos, ShouldExit);
+    double scriptSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < turns; i++)
+        PlayTurn(false);
+    double turnSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << Script.ops.size() << " ops, " << ops << " ops run in " << turns << " turns" << std::endl
+              << "script: " << ops / scriptSec << " ops/sec, "
+              << scriptSec * 1e9 / turns << " ns a turn" << std::endl
+              << "whole headless turn: " << turnSec * 1e9 / turns << " ns" << std::endl;
+}
+
+std::string ScriptToText(const Program& program) {
+    static const char* moves[] = {"left", "right", "up", "down"};
+    std::string text;
+    for (auto& op : program.ops) {
+        switch (op.code) {
+            case OP_MOVE:
+                text += std::string(moves[op.dir]) + " " + std::to_string(op.n) + "\n";
+                break;
+            case OP_REST:
+                text += "rest " + std::to_string(op.n) + "\n";
+                break;
+            case OP_AUTO:
+                text += "auto " + std::to_string(op.n) + "\n";
+                break;
+            case OP_EXIT:
+                text += "exit\n";
+                break;
+            default:
+                break;  // evolved scripts have no control ops
         }
-        if (cmd_idx >= cmds.size()) {
-            cmd_idx = 0;
-            cmds = CmdList;
+    }
+    return text;
+}
+
+Op RandomGene(Random& random) {
+    Op op = {};
+    int kind = random.Int(0, 4);
+    op.code = kind == 4 ? OP_REST : OP_MOVE;
+    op.dir = kind == 4 ? 0 : kind;
+    op.n = random.Int(1, MaxGeneTurns);
+    return op;
+}
+
+void Mutate(Program& program, Random& random) {
+    auto& ops = program.ops;
+    int i = random.Int(0, ops.size() - 1);
+    switch (random.Int(0, 3)) {
+        case 0:
+            ops[i].n = std::clamp(ops[i].n + random.Int(-3, 3), 1, MaxGeneTurns);
+            break;
+        case 1:
+            ops[i] = RandomGene(random);
+            break;
+        case 2:
+            if (ops.size() < MaxGenes)
+                ops.insert(ops.begin() + i, RandomGene(random));
+            break;
+        case 3:
+            if (ops.size() > 1)
+                ops.erase(ops.begin() + i);
+            break;
+    }
+}
+
+// the head of a and the tail of b
+Program Crossover(const Program& a, const Program& b, Random& random) {
+    Program child;
+    int cutA = random.Int(0, a.ops.size()),
+        cutB = random.Int(0, b.ops.size());
+    child.ops.assign(a.ops.begin(), a.ops.begin() + cutA);
+    child.ops.insert(child.ops.end(), b.ops.begin() + cutB, b.ops.end());
+    if (child.ops.size() > MaxGenes)
+        child.ops.resize(MaxGenes);
+    if (child.ops.empty())
+        child.ops.push_back(a.ops.front());
+    return child;
+}
+
+void EvolveScripts(uint64_t seed, int seeds, int threads, int maxTurns,
+                   int generations, int population, const std::string& out) {
+    Random random(seed);
+    std::vector<Candidate> pop(population), next;
+    for (auto& c : pop) {
+        int len = random.Int(1, MaxGenes / 2);
+        for (int i = 0; i < len; i++)
+            c.program.ops.push_back(RandomGene(random));
+    }
+
+    std::atomic<int64_t> turns(0);
+    auto evaluate = [&](WorkPool& pool, std::vector<Candidate>& cands) {
+        std::function<void(int)> task = [&](int i) {
+            if (cands[i].scored)
+                return;
+            int64_t total = 0;
+            for (int s = 0; s < seeds; s++)
+                total += RunHeadless(cands[i].program, seed + s, maxTurns);
+            cands[i].fitness = double(total) / seeds;
+            cands[i].scored = true;
+            turns += total;
+        };
+        pool.Run(cands.size(), task);
+    };
+    // the best of three, pop is sorted
+    auto tournament = [&]() -> const Candidate& {
+        int best = population;
+        for (int k = 0; k < 3; k++)
+            best = std::min(best, random.Int(0, population - 1));
+        return pop[best];
+    };
+
+    std::cout << "evolving " << population << " scripts for " << generations << " generations on seeds "
+              << seed << ".." << seed + seeds - 1 << " with " << threads << " threads" << std::endl;
+    WorkPool pool(threads);
+    Candidate best;
+    int64_t evals = 0;
+    double elapsed = 0;
+    for (int g = 0; g < generations; g++) {
+        int fresh = 0;
+        for (auto& c : pop)
+            fresh += !c.scored;
+        turns = 0;
+        auto begin = std::chrono::steady_clock::now();
+        evaluate(pool, pop);
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        evals += fresh;
+        elapsed += sec;
+
+        std::stable_sort(pop.begin(), pop.end(), [](const Candidate& a, const Candidate& b) {
+            return a.fitness > b.fitness;
+        });
+        if (!best.scored || pop[0].fitness > best.fitness)
+            best = pop[0];
+        double mean = 0;
+        for (auto& c : pop)
+            mean += c.fitness;
+        std::cout << "generation " << g << ": best " << pop[0].fitness
+                  << ", mean " << mean / population
+                  << ", " << fresh / std::max(sec, 1e-9) << " evals/sec, "
+                  << turns / std::max(sec, 1e-9) << " turns/sec" << std::endl;
+
+        next.assign(pop.begin(), pop.begin() + EliteCount);
+        while (next.size() < pop.size()) {
+            Candidate child;
+            if (random.Int(0, 9) < 7)
+                child.program = Crossover(tournament().program, tournament().program, random);
+            else
+                child.program = tournament().program;
+            for (int m = random.Int(1, 2); m > 0; m--)
+                Mutate(child.program, random);
+            next.push_back(std::move(child));
+        }
+        pop.swap(next);
+    }
+    std::cout << evals << " evaluations of " << seeds << " games in " << elapsed << "s, "
+              << evals / std::max(elapsed, 1e-9) << " evals/sec" << std::endl;
+
+    // the same population again on 1, 2, 4 ... threads
+    double base = 0;
+    for (int t = 1; ; t = std::min(t * 2, threads)) {
+        for (auto& c : pop)
+            c.scored = false;
+        WorkPool scaling(t);
+        auto begin = std::chrono::steady_clock::now();
+        evaluate(scaling, pop);
+        double rate = population / std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(), 1e-9);
+        if (t == 1)
+            base = rate;
+        std::cout << "scaling: " << t << " threads, " << rate << " evals/sec, "
+                  << rate / base << "x" << std::endl;
+        if (t == threads)
+            break;
+    }
+
+    std::ifstream old(out);
+    if (old.is_open()) {
+        old.close();
+        std::rename(out.c_str(), (out + ".bak").c_str());
+    }
+    std::ofstream file(out);
+    file << "# evolved by RoboGo --evolve, survives " << best.fitness
+         << " turns on average on seeds " << seed << ".." << seed + seeds - 1 << std::endl
+         << ScriptToText(best.program);
+    std::cout << "best script(" << best.fitness << " turns) is written to " << out << ":" << std::endl
+              << ScriptToText(best.program);
+}
+
+
+void BenchBullets(uint64_t seed, int count) {
+    // a bullet crosses the field in `side` turns, so spawning count / side a turn keeps count alive
+    const int side = 2048;
+    const int spawn = (count + side - 1) / side;
+    surface.reset(new Surface({side, side}));
+    ResetGame(seed, Script);
+    player.pos = {-1, -1};  // out of reach, nobody is hit
+
+    for (int i = 0; i < side; i++) {
+        for (int k = 0; k < spawn; k++)
+            BulCollection.GenNewBullet();
+        BulCollection.Update(false);
+    }
+
+    const int turns = 1000;
+    int64_t updated = 0;
+    double spawnSec = 0, updateSec = 0;
+    for (int i = 0; i < turns; i++) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int k = 0; k < spawn; k++)
+            BulCollection.GenNewBullet();
+        auto mid = std::chrono::steady_clock::now();
+        updated += BulCollection.Count();
+        BulCollection.Update(false);
+        auto end = std::chrono::steady_clock::now();
+        spawnSec += std::chrono::duration<double>(mid - begin).count();
+        updateSec += std::chrono::duration<double>(end - mid).count();
+    }
+
+    std::cout << "field " << side << "x" << side << ", " << spawn << " new bullets a turn, "
+              << updated / turns << " live bullets on average" << std::endl
+              << "update: " << updateSec * 1e6 / turns << " us a turn, "
+              << updateSec * 1e9 / updated << " ns a bullet" << std::endl
+              << "spawn: " << spawnSec * 1e9 / (int64_t(turns) * spawn) << " ns a bullet" << std::endl;
+
+    // robots anywhere on the field, a hit test each
+    const int robots = 1000000;
+    Random random(seed);
+    std::vector<Point> from(robots), to(robots);
+    for (int i = 0; i < robots; i++) {
+        from[i] = {random.Int(0, side - 1), random.Int(0, side - 1)};
+        to[i] = {from[i].x + random.Int(-1, 1), from[i].y};
+    }
+    int hits = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < robots; i++)
+        hits += BulCollection.Hit(from[i], to[i]);
+    double hitSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "hit test: " << hitSec * 1e9 / robots << " ns a robot, "
+              << hits << " of " << robots << " robots hit" << std::endl;
+}
+
+void BenchAutopilot(uint64_t seed) {
+    const int side = 2048;
+    surface.reset(new Surface({side, side}));
+    std::cout << "field " << side << "x" << side << ", " << PlanBudget << " cells a plan at most, "
+              << DangerHorizon << " turns ahead at most" << std::endl;
+    std::printf("%9s %12s %12s %12s %12s %7s\n", "bullets", "first ms", "update us", "plan us", "max us", "depth");
+    for (int count : {0, 1000, 10000, 100000, 300000}) {
+        // as --bench-bullets, count / side new bullets a turn keeps count alive
+        const int spawn = (count + side - 1) / side;
+        ResetGame(seed, Script);
+        for (int i = 0; i < side; i++) {
+            for (int k = 0; k < spawn; k++)
+                BulCollection.GenNewBullet();
+            BulCollection.Update(false);
+        }
+
+        // the first plan sizes the search for the field
+        auto begin = std::chrono::steady_clock::now();
+        Pilot.Plan({side / 2, side / 2}, BulCollection.Danger());
+        double firstSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        // a robot somewhere every turn, the map follows the bullets
+        const int turns = 1000;
+        Random random(seed);
+        double updateSec = 0, planSec = 0, maxSec = 0;
+        int64_t depth = 0;
+        for (int i = 0; i < turns; i++) {
+            begin = std::chrono::steady_clock::now();
+            for (int k = 0; k < spawn; k++)
+                BulCollection.GenNewBullet();
+            BulCollection.Update(false);
+            auto mid = std::chrono::steady_clock::now();
+            Point pos = {random.Int(1, side - 2), random.Int(1, side - 2)};
+            Pilot.Plan(pos, BulCollection.Danger());
+            auto end = std::chrono::steady_clock::now();
+            double sec = std::chrono::duration<double>(end - mid).count();
+            updateSec += std::chrono::duration<double>(mid - begin).count();
+            planSec += sec;
+            maxSec = std::max(maxSec, sec);
+            depth += Pilot.Depth();
+        }
+        std::printf("%9d %12.2f %12.2f %12.2f %12.2f %7.1f\n", BulCollection.Count(), firstSec * 1e3,
+                    updateSec * 1e6 / turns, planSec * 1e6 / turns, maxSec * 1e6, double(depth) / turns);
+    }
+}
+
+void BenchParser(int lines) {
+    // what --evolve writes, with a comment and a loop now and then
+    std::string source;
+    static const char* moves[] = {"left", "right", "up", "down", "rest"};
+    Random random(1);
+    for (int i = 0; i < lines; i++) {
+        if (i % 1000 == 0)
+            source += "# generation " + std::to_string(i / 1000) + "\n";
+        else if (i % 100 == 1)
+            source += "repeat " + std::to_string(random.Int(1, 9)) + "\n";
+        else if (i % 100 == 99)
+            source += "end\n";
+        else
+            source += std::string(moves[random.Int(0, 4)]) + " " + std::to_string(random.Int(1, 12)) + "\n";
+    }
+
+    char path[] = "/tmp/robocmd-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, source.data(), source.size()) != ssize_t(source.size())) {
+        std::cout << "can't write " << path << std::endl;
+        return;
+    }
+    close(fd);
+
+    std::vector<double> secs;
+    Program program;
+    std::string error;
+    for (int run = 0; run < 5; run++) {
+        auto begin = std::chrono::steady_clock::now();
+        bool ok = LoadScript(path, program, error);
+        secs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        if (!ok) {
+            std::cout << path << ":" << error << std::endl;
+            break;
+        }
+    }
+    unlink(path);
+
+    std::sort(secs.begin(), secs.end());
+    double sec = secs[secs.size() / 2];
+    std::cout << lines << " lines, " << source.size() / 1e6 << " MB, " << program.ops.size() << " ops" << std::endl
+              << "load: " << sec * 1e3 << " ms, " << lines / sec << " lines/sec, "
+              << source.size() / 1e6 / sec << " MB/s" << std::endl;
+}
+
+// reads a trace kept in memory
+struct TraceReader {
+    const std::vector<uint8_t>& data;
+    size_t at = 0;
+
+    bool Fixed(uint64_t& v, int bytes) {
+        if (at + bytes > data.size())
+            return false;
+        v = 0;
+        for (int i = 0; i < bytes; i++)
+            v |= uint64_t(data[at++]) << (8 * i);
+        return true;
+    }
+
+    bool Varint(uint64_t& v) {
+        v = 0;
+        for (int shift = 0; at < data.size() && shift < 64; shift += 7) {
+            uint8_t b = data[at++];
+            v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool Int(int& v) {
+        uint64_t u;
+        if (!Varint(u))
+            return false;
+        v = int(u);
+        return true;
+    }
+};
+
+struct TraceKey {
+    int turn;
+    Point pos;
+    BulletGroup groups[4];
+};
+
+bool ReadKeyframe(TraceReader& reader, TraceKey& key) {
+    reader.at++;    // the tag
+    if (!reader.Int(key.turn) || !reader.Int(key.pos.x) || !reader.Int(key.pos.y))
+        return false;
+    for (auto& g : key.groups) {
+        int count;
+        if (!reader.Int(count))
+            return false;
+        g = BulletGroup();
+        for (int i = 0; i < count; i++) {
+            Point p;
+            if (!reader.Int(p.x) || !reader.Int(p.y))
+                return false;
+            g.Add(p);
+        }
+    }
+    return true;
+}
+
+int ReplayTrace(const std::string& filename, int turn, bool play, int delay) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "can't read " << filename << std::endl;
+        return 1;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    TraceReader reader{data};
+    uint64_t seed, w, h, interval;
+    if (data.size() < 5 || std::memcmp(data.data(), TraceMagic, 4) != 0 || data[4] != TraceVersion) {
+        std::cout << filename << " is not a RoboGo trace" << std::endl;
+        return 1;
+    }
+    reader.at = 5;
+    if (!reader.Fixed(seed, 8) || !reader.Fixed(w, 2) || !reader.Fixed(h, 2) || !reader.Fixed(interval, 2)) {
+        std::cout << filename << " is cut in its header" << std::endl;
+        return 1;
+    }
+    if (surface->GetSize().w != int(w) || surface->GetSize().h != int(h))
+        surface.reset(new Surface({int(w), int(h)}));
+
+    // the keyframes, one pass over the records without playing them
+    std::vector<std::pair<int, size_t>> keys;
+    int recorded = 0, ended = -1;
+    bool cut = false;
+    while (reader.at < data.size() && !cut) {
+        uint8_t tag = data[reader.at];
+        if (tag == TraceKeyframe) {
+            size_t at = reader.at;
+            TraceKey key;
+            if (ReadKeyframe(reader, key))
+                keys.emplace_back(key.turn, at);
+            else
+                cut = true;
+        } else if (tag == TraceEnd) {
+            reader.at++;
+            cut = !reader.Int(ended);
+            break;
+        } else {
+            reader.at++;
+            uint64_t extra = 0, v;
+            if ((tag >> 3) == 15)
+                cut = !reader.Varint(extra);
+            for (uint64_t i = 0; i < (tag >> 3) + extra && !cut; i++)
+                cut = !reader.Varint(v);
+            recorded += !cut;
         }
+    }
+    if (keys.empty()) {
+        std::cout << filename << " has no keyframe" << std::endl;
+        return 1;
+    }
 
-        std::cout << TurnCount << " turns.  To exit, press CTRL-C a long time" << std::endl;
-        DealCmd(cmds.at(cmd_idx));
+    int mismatches = 0;
+    auto load = [&](const TraceKey& key) {
+        player.pos = key.pos;
+        BulCollection = BulletCollection();
+        for (int d = 0; d < 4; d++) {
+            for (int i = 0; i < key.groups[d].Size(); i++)
+                BulCollection.AddBullet({Bullet::Direction(d), {key.groups[d].x[i], key.groups[d].y[i]}});
+        }
+        TurnCount = key.turn;
+    };
+    // plays the next turn, the keyframes met on the way are checked; false at the end
+    auto step = [&](bool draw) {
+        while (reader.at < data.size() && data[reader.at] == TraceKeyframe) {
+            TraceKey key;
+            if (!ReadKeyframe(reader, key))
+                return false;
+            bool same = key.turn == TurnCount && key.pos.x == player.pos.x && key.pos.y == player.pos.y;
+            for (int d = 0; d < 4 && same; d++) {
+                const BulletGroup& g = BulCollection.Group(d);
+                same = g.x == key.groups[d].x && g.y == key.groups[d].y;
+            }
+            mismatches += !same;
+        }
+        if (TurnCount >= recorded)
+            return false;
+        uint8_t tag = data[reader.at++];
+        uint64_t spawns = tag >> 3, v;
+        if (spawns == 15) {
+            reader.Varint(v);
+            spawns += v;
+        }
+        if (draw) {
+            surface->Follow(player.pos);
+            surface->Clear();
+            surface->DrawBox({0, 0, int(w) - 1, int(h) - 1}, WallBox);
+        }
+        for (uint64_t i = 0; i < spawns; i++) {
+            reader.Varint(v);
+            Bullet b;
+            b.direction = Bullet::Direction(v & 3);
+            int coord = int(v >> 2);
+            if (b.direction == Bullet::LEFT || b.direction == Bullet::RIGHT)
+                b.pos = {b.direction == Bullet::LEFT ? int(w) : 0, coord};
+            else
+                b.pos = {coord, b.direction == Bullet::UP ? int(h) : 0};
+            BulCollection.AddBullet(b);
+        }
+        BulCollection.Update(draw);
+        if (draw)
+            player.Draw();
+        if (tag & 7)
+            MoveRobo(player.pos, (tag & 7) - 1);
         TurnCount ++;
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        return true;
+    };
+
+    std::cout << filename << ": seed " << seed << ", " << w << "x" << h << ", "
+              << recorded << " turns" << (ended < 0 ? "(no end, the game was killed)" : "") << ", "
+              << keys.size() << " keyframes" << std::endl;
+
+    if (turn < 0 && !play) {
+        // from the first keyframe to the end, every keyframe must match what we played
+        reader.at = keys[0].second;
+        TraceKey key;
+        ReadKeyframe(reader, key);
+        load(key);
+        auto begin = std::chrono::steady_clock::now();
+        while (step(false)) {}
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        bool ok = mismatches == 0 && (ended < 0 || ended == TurnCount);
+        std::cout << "replayed " << TurnCount << " turns in " << sec * 1e3 << " ms("
+                  << TurnCount / std::max(sec, 1e-9) << " turns/sec): " << (ok ? "ok" : "MISMATCH") << std::endl;
+        return ok ? 0 : 1;
+    }
+
+    // seek: the last keyframe not after the turn, then play up to it
+    turn = std::clamp(turn < 0 ? 0 : turn, 0, std::max(recorded - 1, 0));
+    auto key = std::upper_bound(keys.begin(), keys.end(), std::make_pair(turn, SIZE_MAX)) - 1;
+    reader.at = key->second;
+    TraceKey frame;
+    ReadKeyframe(reader, frame);
+    load(frame);
+    while (TurnCount < turn && step(false)) {}
+    if (!step(true)) {
+        std::cout << "turn " << turn << " is not in the trace" << std::endl;
+        return 1;
+    }
+
+    if (!play) {
+        const Rect& view = surface->GetView();
+        for (int y = 0; y < view.size.h; y++)
+            std::cout << std::string(surface->GetRow(y), view.size.w) << std::endl;
+        std::cout << "turn " << turn << " of " << recorded << ", robot at ("
+                  << player.pos.x << ", " << player.pos.y << "), "
+                  << BulCollection.Count() << " bullets" << ViewNote() << std::endl;
+        return 0;
     }
     ClearScreen();
-    std::cout << "Game Over, you survived " << TurnCount << " turns!" << std::endl;
+    do {
+        UpdateScreen(surface.get(), "replay turn " + std::to_string(TurnCount - 1) + " of " + std::to_string(recorded) + ViewNote());
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    } while (step(true));
+    return 0;
+}
+
+// one game, turns[robot] is set to the turns it survived; returns the turns played
+int PlayArena(const std::vector<Program>& programs, uint64_t seed, int maxTurns, std::vector<int>& turns) {
+    BulCollection = BulletCollection();
+    ShouldExit = false;
+    TurnCount = 0;
+    GameSeed = seed;
+    GameRandom.Seed(seed);
+
+    // everybody starts where the single robot does
+    ArenaRobots robots;
+    Point start = {surface->GetSize().w / 2, surface->GetSize().h / 2};
+    for (size_t i = 0; i < programs.size(); i++)
+        robots.Add(i, &programs[i], start);
+    turns.assign(programs.size(), 0);
+
+    std::vector<Bullet> spawned;
+    while (robots.live > 0 && TurnCount < maxTurns) {
+        SpawnBullets(TurnCount, spawned);
+        BulCollection.Update(false);
+
+        // the scripts, each one branches its own way
+        for (int i = 0; i < robots.live; i++) {
+            robots.fromX[i] = robots.x[i];
+            robots.fromY[i] = robots.y[i];
+            Point pos = {robots.x[i], robots.y[i]};
+            bool quit = false;
+            robots.runners[i].Turn(pos, quit);
+            robots.x[i] = pos.x;
+            robots.y[i] = pos.y;
+            robots.quit[i] = quit;
+        }
+
+        // the hits, a few lookups in the danger map a robot
+        TurnCount ++;
+        for (int i = 0; i < robots.live;) {
+            if (robots.quit[i] ||
+                BulCollection.Hit({robots.fromX[i], robots.fromY[i]}, {robots.x[i], robots.y[i]})) {
+                turns[robots.id[i]] = TurnCount;
+                robots.Remove(i);
+            } else {
+                i++;
+            }
+        }
+    }
+    for (int i = 0; i < robots.live; i++)
+        turns[robots.id[i]] = TurnCount;
+    return TurnCount;
+}
+
+void RunArena(const std::vector<std::string>& files, uint64_t seed, int seeds, int threads, int maxTurns) {
+    // a directory brings all of its files
+    std::vector<std::string> paths;
+    for (auto& f : files) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(f, ec)) {
+            std::vector<std::string> inside;
+            for (auto& entry : std::filesystem::directory_iterator(f, ec))
+                if (entry.is_regular_file())
+                    inside.push_back(entry.path().string());
+            std::sort(inside.begin(), inside.end());
+            paths.insert(paths.end(), inside.begin(), inside.end());
+        } else {
+            paths.push_back(f);
+        }
+    }
+
+    std::vector<Program> programs(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::string error;
+        if (!LoadScript(paths[i], programs[i], error)) {
+            std::cout << paths[i] << ":" << error << std::endl;
+            return;
+        }
+        if (programs[i].ops.empty()) {
+            std::cout << "no command in " << paths[i] << std::endl;
+            return;
+        }
+    }
+    if (programs.empty()) {
+        std::cout << "no script for the arena" << std::endl;
+        return;
+    }
+
+    int robots = programs.size();
+    std::vector<std::vector<int>> turns(seeds);
+    std::vector<int> played(seeds);
+    auto begin = std::chrono::steady_clock::now();
+    {
+        WorkPool pool(std::min(threads, seeds));
+        pool.Run(seeds, [&](int s) {
+            played[s] = PlayArena(programs, seed + s, maxTurns, turns[s]);
+        });
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    struct Rank {
+        int robot;
+        double mean = 0;
+        int min = INT32_MAX;
+        int max = 0;
+        int wins = 0;   // seeds it lived longest(ties too)
+    };
+    std::vector<Rank> ranks(robots);
+    int64_t robotTurns = 0;
+    for (int s = 0; s < seeds; s++) {
+        int best = *std::max_element(turns[s].begin(), turns[s].end());
+        for (int r = 0; r < robots; r++) {
+            int t = turns[s][r];
+            ranks[r].robot = r;
+            ranks[r].mean += double(t) / seeds;
+            ranks[r].min = std::min(ranks[r].min, t);
+            ranks[r].max = std::max(ranks[r].max, t);
+            ranks[r].wins += t == best;
+            robotTurns += t;
+        }
+    }
+    std::stable_sort(ranks.begin(), ranks.end(), [](const Rank& a, const Rank& b) {
+        return a.mean > b.mean;
+    });
+
+    std::cout << robots << " robots, " << seeds << " games on seeds " << seed << ".." << seed + seeds - 1 << std::endl;
+    std::printf("%5s  %-32s %9s %7s %7s %6s\n", "rank", "script", "mean", "min", "max", "wins");
+    for (int i = 0; i < robots; i++) {
+        // the same mean, the same rank
+        int rank = i + 1;
+        while (rank > 1 && ranks[rank - 2].mean == ranks[i].mean)
+            rank --;
+        std::string name = std::filesystem::path(paths[ranks[i].robot]).filename().string();
+        std::printf("%5d  %-32s %9.1f %7d %7d %6d\n", rank, name.c_str(),
+                    ranks[i].mean, ranks[i].min, ranks[i].max, ranks[i].wins);
+    }
+    int64_t total = 0;
+    for (int p : played)
+        total += p;
+    std::cout << total << " turns, " << robotTurns << " robot turns in " << sec << "s, "
+              << robotTurns / std::max(sec, 1e-9) << " robot turns/sec" << std::endl;
 }
@@ -1,12 +1,34 @@
 /*
 name: snake
-version: 1.1.0
+version: 1.12.0
 description:
     used ncurses library(Unix System).
     this game only avaliable at UNIX, LINUX, MacOSX platform.
 
 compile:
-    g++ snake.cpp -o snake -lncurses -std=c++11
+    g++ snake.cpp -o snake -lncurses -std=c++11 -pthread
+    add -DPROFILE_SNAKE to time the phases of every tick, the game and --replay then write
+    snake-trace.json(chrome trace, open it in Perfetto or about:tracing) and print p50/p99.
+
+usage:
+    ./snake             play with keyboard(w, a, s, d)
+    ./snake -a          let the autopilot play
+    ./snake --board WxH play on a world larger than the terminal(up to 16384 a side), the screen scrolls
+    ./snake --seed s    play a reproducible game
+    ./snake --portals n n pairs of black holes(1 by default), also for --batch
+    ./snake --record f  save the game into f(seed and direction changes)
+    ./snake --replay f [--tick n]
+                        re-simulate f without ncurses and check it, or print the board at tick n
+    ./snake --arena <snakes> [--board WxH] [--max-ticks n] [--seed s] [--watch]
+                        many AI snakes on one board, print the leaderboard(--watch draws it)
+    ./snake --bench-ai  print the autopilot's decision time on growing boards
+    ./snake --bench-collision
+                        compare virtual and static collision dispatch on a crowded board
+    ./snake --bench-engine
+                        time step, self-collision, food respawn, teleport and a full tick
+                        over snake length and board fill, print JSON(compare it between commits)
+    ./snake --batch <games> [--threads n] [--board WxH] [--max-ticks n] [--seed s] [--portals n]
+                        autopilot self-play without ncurses, print statistics and scaling
 
 log:
 * version 1.0.1
@@ -15,14 +37,50 @@ log:
     refactoryed code, add snake head bold. Fixed bug of turning back.
 * version 1.1.0
     added black hole.
+* version 1.2.0
+    added autopilot(A* to food, tail chasing and hamiltonian cycle fallback).
+* version 1.3.0
+    game rules moved to GameState, added parallel batch self-play.
+* version 1.4.0
+    every game owns a seedable Random(xoshiro128**), added recording and replay.
+* version 1.5.0
+    fixed timestep game loop, keys are read on an input thread and buffered between ticks.
+* version 1.6.0
+    CollisionSystem is a registry with a spatial hash of every occupied cell.
+* version 1.7.0
+    added arena mode, hundreds of AI snakes stored struct-of-arrays.
+* version 1.8.0
+    collision pairs are dispatched through a table of inlined rules instead of virtual hooks.
+* version 1.9.0
+    scrolling worlds larger than the terminal, the body is kept in a bitmap.
+* version 1.10.0
+    PROFILE_SNAKE times the phases of a tick into a chrome trace.
+* version 1.11.0
+    black holes are a table of pairs with their own use counts, spent pairs respawn.
+* version 1.12.0
+    added --bench-engine, microbenchmarks of the per-tick primitives as JSON.
 */
 
 #include <ncurses.h>
 #include <unistd.h>
+#include <poll.h>
 #include <random>
 #include <ctime>
 #include <vector>
 #include <utility>
+#include <queue>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <thread>
+#include <atomic>
 using namespace std;
 using Position = pair<int,int>; //first is x, second is y
 
@@ -30,12 +88,125 @@ using Position = pair<int,int>; //first is x, second is y
 int countnum = 0;
 #endif
 
-//a global variable, because this is a single file.
-bool isgameover = false;
+#ifdef PROFILE_SNAKE
+//class Profiler, scoped timers of the phases of a tick, see PROFILE_PHASE
+class Profiler{
+public:
+    static const chrono::steady_clock::time_point origin;   //program start, ts 0 of the trace
+
+    void add(const char* name, chrono::steady_clock::time_point begin, chrono::steady_clock::time_point end){
+        Event event = {name, us(begin-origin), us(end-begin)};
+        events.push_back(event);
+    }
+
+    //chrome trace-event format, one complete("X") event per phase
+    bool writeTrace(const string& filename){
+        FILE* out = fopen(filename.c_str(), "w");
+        if(!out)
+            return false;
+        fprintf(out, "{\"traceEvents\":[");
+        for(size_t i=0;i<events.size();i++)
+            fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+                    i ? "," : "", events[i].name, events[i].ts, events[i].dur);
+        fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        return fclose(out) == 0;
+    }
+
+    //p50/p99/max of every phase in us, phases in the order they first ran
+    void summary(FILE* out){
+        vector<const char*> names;
+        for(auto& event : events)
+            if(find(names.begin(), names.end(), event.name) == names.end())
+                names.push_back(event.name);
+        fprintf(out, "%-14s %8s %10s %10s %10s\n", "phase", "count", "p50(us)", "p99(us)", "max(us)");
+        vector<double> durs;
+        for(auto name : names){
+            durs.clear();
+            for(auto& event : events)
+                if(event.name == name)
+                    durs.push_back(event.dur);
+            sort(durs.begin(), durs.end());
+            fprintf(out, "%-14s %8zu %10.2f %10.2f %10.2f\n", name, durs.size(),
+                    durs[durs.size()/2], durs[durs.size()*99/100], durs.back());
+        }
+    }
+
+private:
+    struct Event{
+        const char* name;   //a string literal, compared by address
+        double ts;
+        double dur;
+    };
+
+    vector<Event> events;
+
+    static double us(chrono::steady_clock::duration d){
+        return chrono::duration<double, micro>(d).count();
+    }
+};
+
+const chrono::steady_clock::time_point Profiler::origin = chrono::steady_clock::now();
+thread_local Profiler profiler;
+
+class ScopedPhase{
+public:
+    ScopedPhase(const char* name):name(name), begin(chrono::steady_clock::now()){}
+
+    ~ScopedPhase(){
+        profiler.add(name, begin, chrono::steady_clock::now());
+    }
+private:
+    const char* name;
+    chrono::steady_clock::time_point begin;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+//time the rest of the enclosing scope as phase name
+#define PROFILE_PHASE(name) ScopedPhase PROFILE_CONCAT(profilephase, __LINE__)(name)
+#else
+#define PROFILE_PHASE(name)
+#endif
+
+//global variables, because this is a single file.
+//thread_local, so every thread of batch mode plays its own game.
+thread_local bool isgameover = false;
+thread_local int boardw = 0;    //the size of board, COLS x LINES in ncurses game
+thread_local int boardh = 0;
+thread_local Position camera(0, 0);    //the world cell at the top-left corner of the terminal
+
+//the largest side of a world, the body bitmap of Snake is then 32MB.
+//the arena keeps 16 bytes a cell, it takes at most MAX_ARENA_CELLS(256MB)
+const int MAX_BOARD = 16384;
+const int MAX_ARENA_CELLS = 1<<24;
 
 enum ObjectType{SOLID,
                 SIMPLE_FOOD, FUNCTIONAL_FOOD};   //for collision
 enum Direction{LEFT, RIGHT, TOP, BOTTOM};   //for moving
+enum EntityKind{SNAKE_ENTITY, FOOD_ENTITY, BLACK_HOLE_ENTITY,
+                ENTITY_COUNT};  //the closed set of objects, for static collision dispatch
+
+//the first cell of a view on a world, centered on p when the world is larger than the view
+int centerView(int p, int view, int world){
+    return max(0, min(p-view/2, world-view));
+}
+
+//a cell as a hash key, and the hash of it(fibonacci hashing)
+uint64_t cellKey(Position p){
+    return (uint64_t(uint32_t(p.first))<<32)|uint32_t(p.second);
+}
+
+uint32_t cellHash(uint64_t k){
+    k *= 0x9e3779b97f4a7c15ULL;
+    return k>>32;
+}
+
+//draw c at world cell p, cells outside the terminal are skipped
+void drawCell(Position p, chtype c){
+    int x = p.first-camera.first, y = p.second-camera.second;
+    if(x >= 0 && x < COLS && y >= 0 && y < LINES)
+        mvaddch(y, x, c);
+}
 
 class Food;
 class Score;
@@ -43,31 +214,101 @@ class Snake;
 class GameMain;
 class Controller;
 
-//Random use to generate random number
+//Random use to generate random number.
+//xoshiro128** seeded by splitmix64, every game owns one, so a game is reproducible from its seed.
 class Random{
 public:
-    static int getInt(){
-        checkInit();
-        return rand();
+    Random(uint64_t seed = 0){
+        this->seed(seed);
+    }
+
+    void seed(uint64_t seed){
+        for(int i=0;i<4;i+=2){
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+            z = (z^(z>>27))*0x94d049bb133111ebULL;
+            z ^= z>>31;
+            state[i] = uint32_t(z);
+            state[i+1] = uint32_t(z>>32);
+        }
+    }
+
+    int getInt(){
+        return next()>>1;
     }
-    static int getRange(int max, int min){
-        checkInit();
+
+    //in [min, max-2], the border is at 0 and max-1
+    int getRange(int max, int min){
         int mod = max-min-1;
-        if(mod == 0)
+        if(mod <= 0)
             mod = 1;
-        return rand()%mod+min;
+        return getInt()%mod+min;
     }
+
 private:
-    static void checkInit(){
-        if(!isinit){
-            srand(time(nullptr));
-            isinit = true;
-        }
+    uint32_t state[4];
+
+    static uint32_t rotl(uint32_t x, int k){
+        return (x<<k)|(x>>(32-k));
+    }
+
+    uint32_t next(){
+        uint32_t result = rotl(state[1]*5, 7)*9;
+        uint32_t t = state[1]<<9;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 11);
+        return result;
     }
-    static bool isinit;
 };
 
-bool Random::isinit = false;
+//class BitGrid, one bit per cell of a w x h world(10000 x 10000 is 12.5MB)
+class BitGrid{
+public:
+    BitGrid(){
+        w = h = 0;
+    }
+
+    void resize(int w, int h){
+        this->w = w;
+        this->h = h;
+        bits.assign((size_t(w)*h+63)/64, 0);
+    }
+
+    //cells outside the world are never set
+    bool get(Position p) const{
+        if(!inside(p))
+            return false;
+        size_t i = index(p);
+        return bits[i>>6]>>(i&63)&1;
+    }
+
+    void set(Position p, bool value){
+        if(!inside(p))
+            return;
+        size_t i = index(p);
+        if(value)
+            bits[i>>6] |= uint64_t(1)<<(i&63);
+        else
+            bits[i>>6] &= ~(uint64_t(1)<<(i&63));
+    }
+
+private:
+    int w;
+    int h;
+    vector<uint64_t> bits;
+
+    bool inside(Position p) const{
+        return p.first >= 0 && p.first < w && p.second >= 0 && p.second < h;
+    }
+
+    size_t index(Position p) const{
+        return size_t(p.second)*w+p.first;
+    }
+};
 
 class Object{
 public:
@@ -75,6 +316,10 @@ public:
         return type;
     };
 
+    EntityKind getKind(){
+        return kind;
+    }
+
     virtual Position getPos(){
         return pos;
     }
@@ -83,6 +328,20 @@ public:
         pos = newpos;
     }
 
+    //every cell the object covers, for the broadphase of CollisionSystem
+    virtual void cells(vector<Position>& out){
+        out.push_back(getPos());
+    }
+
+    //an object keeping its own grid gives only a few cells to cells(), occupies() tells the rest
+    virtual bool hasGrid(){
+        return false;
+    }
+
+    virtual bool occupies(Position p){
+        return false;
+    }
+
     //befor collision, collision, after collision
     virtual void precollision(Object& obj) = 0;
     virtual void collision(Object& obj) = 0;
@@ -92,197 +351,386 @@ public:
 protected:
     Position pos;
     ObjectType type;
+    EntityKind kind;
 };
 
+//class CollisionSystem, objects are registered once and detect() finds all colliding pairs.
+/*
+Every tick the cells of the objects are sorted by key, objects in a run of one key are a
+pair. The body of a snake is not in there: Snake keeps it in a BitGrid, and every other cell
+is looked up in the grid instead, so a tick costs the heads and small objects, not the length
+of the snake. Pairs are dispatched in registration order, each pair once, even if the objects
+share many cells. The hooks still decide what the touch means(e.g. food is eaten only by the head).
+
+Snake, Food and BlackHoleTable are the only objects, so by default a pair is dispatched through
+a table indexed by their kinds. Every entry is a template instantiated for one pair of final
+classes, it calls the same rules as the virtual hooks but the compiler inlines them.
+VIRTUAL_DISPATCH keeps the old path, --bench-collision compares both.
+*/
 class CollisionSystem{
 public:
-    CollisionSystem(){}
-    void collision(Object& obj1, Object& obj2){
-        if(obj1.getPos() == obj2.getPos()){
-            obj1.precollision(obj2);
-            obj2.precollision(obj1);
-            obj1.collision(obj2);
-            obj2.collision(obj1);
-            obj1.aftercollision();
-            obj2.aftercollision();
-        }
-    }
-};
+    enum Dispatch{STATIC_DISPATCH, VIRTUAL_DISPATCH};
 
-//class Obstical
-class BlackHole : public Object{
-public:
-    static char BLACK_HOLE;
-
-    BlackHole(int uc, Position pos, BlackHole* another){
-        isshow = false;
-        this->type = SOLID;
-        this->usecount = uc;
-        this->pos = pos;
-        this->another = another;
-        iscol = false;
-        assert(pos != another->getPos());
-        assert(usecount>0);
+    CollisionSystem(){
+        mode = STATIC_DISPATCH;
     }
 
-    BlackHole(int uc, BlackHole* another){
-        isshow = false;
-        this->type = SOLID;
-        this->usecount = uc;
-        iscol = false;
-        pos = make_pair(Random::getRange(COLS, 1), Random::getRange(LINES, 1));
-        this->another = another;
-        if(another != nullptr)
-            assert(pos != another->getPos());
+    void setDispatch(Dispatch d){
+        mode = d;
     }
 
-    void show(){
-        isshow = true;
+    int getPairs(){
+        return pairs.size();
     }
 
-    void hide(){
-        isshow = false;
+    void add(Object* obj){
+        objects.push_back(obj);
     }
 
-    void link(BlackHole* an){
-        another = an;
+    void remove(Object* obj){
+        objects.erase(std::remove(objects.begin(), objects.end(), obj), objects.end());
     }
 
-    int getusecount(){
-        return usecount;
+    void clear(){
+        objects.clear();
     }
 
-    void decreaseusecount(){
-        usecount--;
+    void detect(){
+        collect();
+        findPairs();
+        dispatch();
     }
 
-    //collision
-    void precollision(Object& obj) override{}
-    void collision(Object& obj) override{
-        if(iscol || !isshow)
+    //run the hooks of the pairs found by the last detect()
+    void dispatch(){
+        if(mode == VIRTUAL_DISPATCH){
+            for(auto& pair : pairs)
+                collision(*objects[pair.first], *objects[pair.second]);
             return ;
-        Position objpos = obj.getPos();
-        if(objpos == pos){
-            obj.setPos(another->getPos());
-            another->decreaseusecount();
-            another->post();
+        }
+        for(auto& pair : pairs){
+            Object& obj1 = *objects[pair.first];
+            Object& obj2 = *objects[pair.second];
+            rules[obj1.getKind()][obj2.getKind()](obj1, obj2);
         }
     }
 
-    void aftercollision() override{
-        if(isshow && !iscol){
-            iscol = true;
-            decreaseusecount();
-        }
+    //dispatch the hooks between two objects
+    void collision(Object& obj1, Object& obj2){
+        obj1.precollision(obj2);
+        obj2.precollision(obj1);
+        obj1.collision(obj2);
+        obj2.collision(obj1);
+        obj1.aftercollision();
+        obj2.aftercollision();
     }
 
-    void draw() override{
-        if(isshow && usecount > 0){
-            attron(COLOR_PAIR(5)|A_BOLD);
-            mvaddch(pos.second, pos.first, BLACK_HOLE);
-            attroff(COLOR_PAIR(5)|A_BOLD);
+private:
+    struct Entry{
+        uint64_t key;
+        int obj;
+        Position cell;
+
+        bool operator<(const Entry& o) const{
+            return key != o.key ? key < o.key : obj < o.obj;
         }
-    }
+    };
 
-    void update(){
-        if(usecount <= 0)
-            isshow = false;
-        iscol = false;
+    typedef void (*Rule)(Object&, Object&);
+    static const Rule rules[ENTITY_COUNT][ENTITY_COUNT];
+
+    Dispatch mode;
+    vector<Object*> objects;
+    vector<Position> scratch;
+    vector<Entry> entries;
+    vector<int> grids;  //objects with hasGrid()
+    vector<pair<int,int> > pairs;
+
+    void collect(){
+        entries.clear();
+        grids.clear();
+        for(size_t i=0;i<objects.size();i++){
+            scratch.clear();
+            bool grid;
+            if(mode == VIRTUAL_DISPATCH){
+                objects[i]->cells(scratch);
+                grid = objects[i]->hasGrid();
+            }else{
+                cellsOf(*objects[i], scratch);
+                grid = objects[i]->getKind() == SNAKE_ENTITY;
+            }
+            if(grid)
+                grids.push_back(i);
+            for(auto& p : scratch){
+                Entry e = {cellKey(p), (int)i, p};
+                entries.push_back(e);
+            }
+        }
+        sort(entries.begin(), entries.end());
+    }
+
+    void findPairs(){
+        pairs.clear();
+        for(size_t i=0;i<entries.size();){
+            size_t end = i+1;
+            while(end < entries.size() && entries[end].key == entries[i].key)
+                end++;
+            for(size_t a=i;a<end;a++)
+                for(size_t b=a+1;b<end;b++)
+                    if(entries[a].obj != entries[b].obj)
+                        pairs.push_back(make_pair(entries[a].obj, entries[b].obj));
+            i = end;
+        }
+        for(int g : grids)
+            for(auto& e : entries)
+                if(e.obj != g && occupiesOf(*objects[g], e.cell))
+                    pairs.push_back(make_pair(min(g, e.obj), max(g, e.obj)));
+        sort(pairs.begin(), pairs.end());
+        pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
     }
 
-private:
-    int usecount;
-    BlackHole* another;
-    bool isshow;
-    bool iscol;
-    void post(){
-        iscol = true;
-    }
+    bool occupiesOf(Object& obj, Position p);   //defined after Snake
+    static void cellsOf(Object& obj, vector<Position>& out);    //defined after Snake
 };
 
-char BlackHole::BLACK_HOLE = 'O';
-
-//the group of black hole(bind 2 black holes)
+//class BlackHoleTable, every black hole of the level.
 /*
-Should I declare a virtual class Group, and inherit it?It may simplify the collision.
+Black holes come in pairs, a head entering one end comes out of the other and the pair is
+used once, a spent pair respawns somewhere else(never on the snake, the food or another
+black hole). The pairs are one vector and an open addressing hash maps a cell to its end,
+so the head is checked with one lookup however many pairs there are. The hash only changes
+when a pair moves.
 */
-class BHGroup{
+class BlackHoleTable final : public Object{
 public:
-    BHGroup(BlackHole nbh1, BlackHole nbh2):bh1(nbh1), bh2(nbh2){}
-    BHGroup(int count):bh1(count, nullptr), bh2(count, nullptr){
-        bh1.link(&bh2);
-        bh2.link(&bh1);
+    static char BLACK_HOLE;
+
+    struct Pair{
+        Position end[2];
+        int uses;   //0 is spent, not on the board
+    };
+
+    BlackHoleTable(int pairs = 1, int uses = 4){
+        type = SOLID;
+        kind = BLACK_HOLE_ENTITY;
+        pos = make_pair(-1, -1);    //not a cell, see cells()
+        snake = nullptr;
+        food = nullptr;
+        random = nullptr;
+        reset(pairs, uses);
+    }
+
+    //n spent pairs, place() puts them on the board with uses each
+    void reset(int n, int uses){
+        this->uses = uses;
+        Pair spent = {{make_pair(-1, -1), make_pair(-1, -1)}, 0};
+        table.assign(n, spent);
+        shown = false;
+        spentpair = -1;
+        rebuild();
+    }
+
+    //black holes never appear on s or f, and take their positions from r
+    void init(Snake* s, Food* f, Random* r){
+        snake = s;
+        food = f;
+        random = r;
+    }
+
+    void place(){
+        for(size_t i=0;i<table.size();i++)
+            respawn(i);
     }
 
-    void chanegPos(){
-        bh1.setPos(make_pair(Random::getRange(COLS,1), Random::getRange(LINES, 1)));
-        bh2.setPos(make_pair(Random::getRange(COLS,1), Random::getRange(LINES, 1)));
+    //put pair i at a and b with full uses
+    void setPair(int i, Position a, Position b){
+        table[i].end[0] = a;
+        table[i].end[1] = b;
+        table[i].uses = uses;
+        rebuild();
     }
 
+    void respawn(int i);
+
     void show(){
-        bh1.show();
-        bh2.show();
+        shown = true;
     }
 
     void hide(){
-        bh1.hide();
-        bh2.hide();
+        shown = false;
     }
 
-    void draw(){
-        bh1.draw();
-        bh2.draw();
+    bool isShow(){
+        return shown;
+    }
+
+    //the end(pair*2+end) of the black hole shown at p, -1 if none
+    int find(Position p){
+        return shown ? lookup(p) : -1;
+    }
+
+    bool isBlackHole(Position p){
+        return find(p) >= 0;
+    }
+
+    //a pair is placed at p, shown or not
+    bool covers(Position p){
+        return lookup(p) >= 0;
+    }
+
+    const vector<Pair>& getPairs(){
+        return table;
+    }
+
+    void cells(vector<Position>& out) override{
+        if(!shown)
+            return;
+        for(auto& pair : table)
+            if(pair.uses > 0){
+                out.push_back(pair.end[0]);
+                out.push_back(pair.end[1]);
+            }
+    }
+
+    //collision
+    void precollision(Object& obj) override{}
+    void collision(Object& obj) override{
+        hit(obj);
+    }
+
+    void aftercollision() override{
+        settle();
     }
 
-    BlackHole& getBlackHole1(){
-        return bh1;
+    //the rules behind collision() and aftercollision(), typed for static dispatch
+    template <typename T>
+    void hit(T& obj){
+        if(obj.getKind() != SNAKE_ENTITY)
+            return;
+        int id = find(obj.getPos());
+        if(id < 0)
+            return;
+        Pair& pair = table[id>>1];
+        obj.setPos(pair.end[(id&1)^1]);
+        if(--pair.uses == 0)
+            spentpair = id>>1;
     }
 
-    BlackHole& getBlackHole2(){
-        return bh2;
+    void settle(){
+        if(spentpair >= 0)
+            respawn(spentpair);
+        spentpair = -1;
     }
 
-    void update(){
-        bh1.update();
-        bh2.update();
+    void draw() override{
+        if(!shown)
+            return;
+        attron(COLOR_PAIR(5)|A_BOLD);
+        for(auto& pair : table)
+            if(pair.uses > 0){
+                drawCell(pair.end[0], BLACK_HOLE);
+                drawCell(pair.end[1], BLACK_HOLE);
+            }
+        attroff(COLOR_PAIR(5)|A_BOLD);
     }
 
 private:
-    BlackHole bh1;
-    BlackHole bh2;
+    static const int MAX_TRIES = 1000;  //a pair that finds no free cell stays spent
+    vector<Pair> table;
+    vector<int> slots;  //pair*2+end, -1 is empty
+    vector<uint64_t> keys;
+    int uses;
+    int spentpair;
+    bool shown;
+    Snake* snake;
+    Food* food;
+    Random* random;
+
+    int lookup(Position p){
+        uint64_t k = cellKey(p);
+        size_t mask = slots.size()-1;
+        for(size_t i=cellHash(k)&mask;slots[i]!=-1;i=(i+1)&mask)
+            if(keys[i] == k)
+                return slots[i];
+        return -1;
+    }
+
+    void rebuild(){
+        size_t size = 16;
+        while(size < table.size()*4)
+            size *= 2;
+        slots.assign(size, -1);
+        keys.assign(size, 0);
+        for(size_t i=0;i<table.size();i++){
+            if(table[i].uses <= 0)
+                continue;
+            for(int e=0;e<2;e++){
+                uint64_t k = cellKey(table[i].end[e]);
+                size_t j = cellHash(k)&(size-1);
+                while(slots[j] != -1)
+                    j = (j+1)&(size-1);
+                slots[j] = i*2+e;
+                keys[j] = k;
+            }
+        }
+    }
 };
 
+char BlackHoleTable::BLACK_HOLE = 'O';
+
 //class Food
-class Food:public Object{
+class Food final : public Object{
 public:
     Food(){
         type = ObjectType::SIMPLE_FOOD;
-        changePos();
+        kind = FOOD_ENTITY;
+        snake = nullptr;
+        random = nullptr;
+        blackholes = nullptr;
+        eaten = false;
+        pos = make_pair(0, 0);
+    }
+
+    //food never appears on s or a black hole of t, and takes its position from r
+    void init(Snake* s, Random* r, BlackHoleTable* t = nullptr){
+        snake = s;
+        random = r;
+        blackholes = t;
     }
 
     void draw() override{
         attron(COLOR_PAIR(2));
-        mvaddch(pos.second, pos.first, FOOD);
+        drawCell(pos, FOOD);
         attroff(COLOR_PAIR(2));
     }
     
-    void changePos(){
-        int x = Random::getRange(COLS, 1);
-        int y = Random::getRange(LINES, 1);
-        while(!mvinch(y, x)){
-            int x = Random::getRange(COLS, 1);
-            int y = Random::getRange(LINES, 1);
-        }
-        pos = make_pair(x, y);
-    }
+    void changePos();
 
-    void collision(Object& o) override{}
+    void collision(Object& o) override{
+        hit(o);
+    }
     void precollision(Object& o) override{}
     void aftercollision() override{
-        changePos();
+        settle();
+    }
+
+    template <typename T>
+    void hit(T& o){
+        if(o.getKind() == SNAKE_ENTITY && o.getPos() == pos)
+            eaten = true;
+    }
+
+    void settle(){
+        if(eaten)
+            changePos();
+        eaten = false;
     }
 private:
     static const char FOOD = 'D';
+    Snake* snake;
+    Random* random;
+    BlackHoleTable* blackholes;
+    bool eaten;
 };
 
 //class Score
@@ -314,16 +762,31 @@ private:
 };
 
 //class Snake
-class Snake:public Object{
+class Snake final : public Object{
 public:
     Snake(){
         direction = LEFT;
         type = SOLID;
+        kind = SNAKE_ENTITY;
+        score = nullptr;
     }
 
     void init(Score* s){
-        addBody(make_pair(COLS/2, LINES/2));
-        addBody(make_pair(COLS/2+1, LINES/2));
+        init(s, make_pair(boardw/2, boardh/2));
+    }
+
+    void init(Score* s, Position head){
+        vector<Position> cells;
+        cells.push_back(head);
+        cells.push_back(make_pair(head.first+1, head.second));
+        init(s, cells);
+    }
+
+    //a snake laid on cells, cells[0] is the head
+    void init(Score* s, const vector<Position>& cells){
+        occupied.resize(boardw, boardh);
+        for(auto& cell : cells)
+            addBody(cell);
         pos = body[0];
         score = s;
     }
@@ -333,13 +796,20 @@ public:
     }
 
     void addBody(Position node){
+        if(!body.empty())
+            occupied.set(node, true);
         body.push_back(node);
     }
 
+    //is p under the head or the body
+    bool occupies(Position p) override{
+        return p == body[0] || occupied.get(p);
+    }
+
     void drawHead(){
         //init_color(COLOR_YELLOW, 700, 700, 0);
         attron(COLOR_PAIR(3)|A_BOLD);
-        mvaddch(body[0].second, body[0].first, SNAKE_BODY);
+        drawCell(body[0], SNAKE_BODY);
         attroff(COLOR_PAIR(3)|A_BOLD);
         //init_color(COLOR_YELLOW, 1000, 1000, 0);
     }
@@ -350,7 +820,7 @@ public:
             #ifdef DEBUG_SNAKE
             mvprintw(i, 0, "snake[%d]: x->%d, y->%d", i, body[i].first, body[i].second);
             #endif
-            mvaddch(body[i].second, body[i].first, SNAKE_BODY);
+            drawCell(body[i], SNAKE_BODY);
         }
         attroff(COLOR_PAIR(3));
     }
@@ -360,7 +830,7 @@ public:
         drawBody();
     }
 
-    vector<Position> getBody(){
+    const vector<Position>& getBody(){
         return body;
     }
 
@@ -373,8 +843,12 @@ public:
     }
 
     void step(){
+        Position tail = body.back();
         body.pop_back();
+        if(body.size() == 1 || body.back() != tail)   //a grown snake has the tail twice
+            occupied.set(tail, false);
         Position head = body[0];
+        occupied.set(head, true);
         if(direction == LEFT)
             head.first--;
         else if(direction == RIGHT)
@@ -399,151 +873,1106 @@ public:
     }
 
     void collisionBorder(){
-        Position head = body[0];
-        for(int i=1;i<body.size();i++)
-            if(head.first == body[i].first && head.second == body[i].second){ 
-                isgameover = true;
-                return ;
-            }
-        if(head.first == 0 || head.first == COLS-1 || head.second == 0 || head.second == LINES-1){
+        if(isDead(boardw, boardh))
             isgameover = true;
-            return ;
-        }
+    }
+
+    //the head hit body or the border of a w x h board
+    bool isDead(int w, int h){
+        Position head = body[0];
+        if(occupied.get(head))
+            return true;
+        return head.first == 0 || head.first == w-1 || head.second == 0 || head.second == h-1;
     }
 
     void precollision(Object& obj) override{}
 
+    //only the head, the body is in occupied
+    void cells(vector<Position>& out) override{
+        out.push_back(body[0]);
+    }
+
+    bool hasGrid() override{
+        return true;
+    }
+
     void collision(Object& obj) override{
-        if(obj.getType() == SIMPLE_FOOD){
-            Position head = body[0];
-            Position foodPos = obj.getPos();
+        hit(obj);
+    }
+
+    void aftercollision() override{}
+
+    template <typename T>
+    void hit(T& obj){
+        if(obj.getType() == SIMPLE_FOOD && obj.getPos() == body[0]){
             Position tail = body[body.size()-1];
             addBody(tail);
             score->increase(1);
         }
     }
 
-    void aftercollision() override{}
+    void settle(){}
 private:
     static const char SNAKE_BODY = 'S';
     vector<Position> body;
+    BitGrid occupied;   //body[1..], the head moves by setPos() without touching it
     Direction direction;
     Score* score;
 };
 
-//class Controller
+void Food::changePos(){
+    Position p;
+    do{
+        p = make_pair(random->getRange(boardw, 1), random->getRange(boardh, 1));
+    }while((snake && snake->size() > 0 && snake->occupies(p)) || (blackholes && blackholes->covers(p)));
+    pos = p;
+}
+
+void BlackHoleTable::respawn(int i){
+    Pair& pair = table[i];
+    pair.uses = 0;
+    rebuild();
+    for(int e=0;e<2;e++){
+        Position p;
+        int tries = 0;
+        do{
+            p = make_pair(random->getRange(boardw, 1), random->getRange(boardh, 1));
+            if(++tries > MAX_TRIES)
+                return;
+        }while(snake->occupies(p) || p == food->getPos() || lookup(p) >= 0 || (e == 1 && p == pair.end[0]));
+        pair.end[e] = p;
+    }
+    pair.uses = uses;
+    rebuild();
+}
+
+//one pair of the static dispatch table, precollision() is empty for every object so it's skipped
+template <typename A, typename B>
+void collideStatic(Object& obj1, Object& obj2){
+    A& a = static_cast<A&>(obj1);
+    B& b = static_cast<B&>(obj2);
+    a.hit(b);
+    b.hit(a);
+    a.settle();
+    b.settle();
+}
+
+const CollisionSystem::Rule CollisionSystem::rules[ENTITY_COUNT][ENTITY_COUNT] = {
+    {collideStatic<Snake, Snake>, collideStatic<Snake, Food>, collideStatic<Snake, BlackHoleTable>},
+    {collideStatic<Food, Snake>, collideStatic<Food, Food>, collideStatic<Food, BlackHoleTable>},
+    {collideStatic<BlackHoleTable, Snake>, collideStatic<BlackHoleTable, Food>, collideStatic<BlackHoleTable, BlackHoleTable>}
+};
+
+bool CollisionSystem::occupiesOf(Object& obj, Position p){
+    if(mode == VIRTUAL_DISPATCH)
+        return obj.occupies(p);
+    return static_cast<Snake&>(obj).occupies(p);
+}
+
+void CollisionSystem::cellsOf(Object& obj, vector<Position>& out){
+    switch(obj.getKind()){
+    case SNAKE_ENTITY:
+        static_cast<Snake&>(obj).cells(out);
+        break;
+    case FOOD_ENTITY:
+        out.push_back(static_cast<Food&>(obj).getPos());
+        break;
+    default:
+        static_cast<BlackHoleTable&>(obj).cells(out);
+    }
+}
+
+//class Controller, decide where the snake goes
 class Controller{
 public:
-    Controller(){}
-
-    void control(Snake& snake){
-        Direction direction = snake.getDirection();
-        switch(getch()){
-            case 'a':
-                if(snake[0].first-1 != snake[1].first)
-                    direction = LEFT;
-                break;
-            case 'w':
-                if(snake[0].second-1 != snake[1].second)
-                    direction = TOP;
-                break;
-            case 'd':
-                if(snake[0].first+1 != snake[1].first)
-                    direction = RIGHT;
-                break;
-            case 's':
-                if(snake[0].second+1 != snake[1].second)
-                    direction = BOTTOM;
-                break;
-        }
-        snake.setDirection(direction);
+    virtual ~Controller(){}
+    virtual void control(Snake& snake) = 0;
+};
+
+//class SpscQueue, lock-free ring buffer for one producer thread and one consumer thread
+template <typename T, int N>
+class SpscQueue{
+public:
+    SpscQueue():head(0), tail(0){}
+
+    bool push(const T& value){
+        int t = tail.load(memory_order_relaxed);
+        int next = (t+1)%N;
+        if(next == head.load(memory_order_acquire))
+            return false;   //full
+        buf[t] = value;
+        tail.store(next, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value){
+        int h = head.load(memory_order_relaxed);
+        if(h == tail.load(memory_order_acquire))
+            return false;   //empty
+        value = buf[h];
+        head.store((h+1)%N, memory_order_release);
+        return true;
     }
 private:
+    T buf[N];
+    atomic<int> head;
+    atomic<int> tail;
+};
+
+struct KeyEvent{
+    int key;
+    chrono::steady_clock::time_point time;
 };
 
-class GameMain{
+using KeyQueue = SpscQueue<KeyEvent, 64>;
+
+//class InputReader, read keys from stdin on its own thread, so typing never changes the tick rate
+class InputReader{
 public:
-    GameMain():bhgroup(4){
-        init_config();
-        init_color();
-        timecount = 0;
-        snake.init(&score);
-        food.changePos();
-        bhgroup.chanegPos();
-        bhgroup.hide();
+    InputReader(){
+        running = false;
     }
 
-    void init_color(){
-        init_pair(1, COLOR_GREEN, COLOR_BLACK);     //text color, score color
-        init_pair(2, COLOR_BLUE, COLOR_BLACK);      //food color
-        init_pair(3, COLOR_YELLOW, COLOR_BLACK);    //snake color
-        init_pair(4, COLOR_RED, COLOR_BLACK);       //game over text
-        init_pair(5, COLOR_MAGENTA, COLOR_WHITE);   //black hole
+    ~InputReader(){
+        stop();
     }
 
-    void init_config(){
-        isgameover = false;
-        initscr();
-        if(has_colors() == FALSE){
-            endwin();
-            isgameover = true;
+    void start(){
+        running = true;
+        worker = thread(&InputReader::loop, this);
+    }
+
+    void stop(){
+        running = false;
+        if(worker.joinable())
+            worker.join();
+    }
+
+    KeyQueue& getQueue(){
+        return queue;
+    }
+private:
+    KeyQueue queue;
+    atomic<bool> running;
+    thread worker;
+
+    void loop(){
+        pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        unsigned char buf[16];
+        while(running){
+            if(poll(&pfd, 1, 20) <= 0)  //wake up sometimes to see if we should stop
+                continue;
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            KeyEvent event;
+            event.time = chrono::steady_clock::now();
+            for(ssize_t i=0;i<n;i++){
+                event.key = buf[i];
+                queue.push(event);
+            }
         }
-        start_color();
-        curs_set(0);
-        cbreak();
-        noecho();
-        keypad(stdscr, TRUE);
-        //srand(time(nullptr));
     }
+};
 
-    void drawGameBody(){
-        clear();
-        drawItems();
-        controller.control(snake);
-        collisionTest();
-        updates();
-        #ifdef DEBUG_SNAKE
-        mvprintw(LINES-1, 0, "count:%d", countnum++);
-        #endif
-        refresh();
+//class KeyboardController, control snake by w, a, s, d
+/*
+keys pressed between two ticks stay in the queue, one turn is taken every tick,
+so a quick "w a" still turns up and then left.
+*/
+class KeyboardController : public Controller{
+public:
+    KeyboardController(KeyQueue* queue):queue(queue){
+        applied = false;
+    }
+
+    void control(Snake& snake) override{
+        applied = false;
+        KeyEvent event;
+        while(queue->pop(event)){
+            Direction direction = snake.getDirection();
+            switch(event.key){
+                case 'a':
+                    if(snake[0].first-1 != snake[1].first)
+                        direction = LEFT;
+                    break;
+                case 'w':
+                    if(snake[0].second-1 != snake[1].second)
+                        direction = TOP;
+                    break;
+                case 'd':
+                    if(snake[0].first+1 != snake[1].first)
+                        direction = RIGHT;
+                    break;
+                case 's':
+                    if(snake[0].second+1 != snake[1].second)
+                        direction = BOTTOM;
+                    break;
+            }
+            if(direction != snake.getDirection()){
+                snake.setDirection(direction);
+                applied = true;
+                keytime = event.time;
+                return;
+            }
+        }
     }
 
-    void drawItems(){
-        box(stdscr, 0, 0);
-        score.draw();
-        food.draw();
-        snake.draw();
-        bhgroup.draw();
+    //the press time of the key that turned the snake in the last tick
+    bool lastTurn(chrono::steady_clock::time_point& time){
+        time = keytime;
+        return applied;
     }
+private:
+    KeyQueue* queue;
+    bool applied;
+    chrono::steady_clock::time_point keytime;
+};
 
-    void collisionTest(){
-        colsystem.collision(snake, food);
-        colsystem.collision(snake, bhgroup.getBlackHole1());
-        colsystem.collision(snake, bhgroup.getBlackHole2());
-        snake.collisionBorder();
+//class PathFinder, search on the occupancy grid of a w x h board(border is wall).
+/*
+Every body cell remember the tick it becomes free(the tail leaves first), so a cell
+reached at tick t is passable when freeat <= t. Arrays are stamped instead of cleared,
+so one search only costs the cells it touches.
+A world larger than MAX_WINDOW is searched in a window around the head(see center()),
+cells outside the window are walls, so memory doesn't grow with the world.
+*/
+class PathFinder{
+public:
+    static const int BLOCKED = 0x3fffffff;
+    static const int MAX_WINDOW = 512;
+
+    PathFinder(int w, int h):w(min(w, MAX_WINDOW)), h(min(h, MAX_WINDOW)),
+        freeat(this->w*this->h, 0), freestamp(this->w*this->h, 0), visitstamp(this->w*this->h, 0),
+        dist(this->w*this->h, 0), from(this->w*this->h, -1){
+        worldw = w;
+        worldh = h;
+        ox = oy = 0;
+        curfree = 0;
+        curvisit = 0;
     }
 
-    void updates(){
-        snake.step();
-        bhgroup.update();
-        if(timecount >= 500)
-            bhgroup.show();
+    int width(){
+        return w;
     }
 
-    void drawWelcome(){
-        clear();
-        box(stdscr, 0, 0);
-        attron(A_BOLD);
-        mvprintw(LINES/2-1, COLS/2-5, "snake game");
-        attroff(A_BOLD);
-        attron(COLOR_PAIR(1)|A_UNDERLINE);
-        mvprintw(LINES/2, COLS/2-11, "press any key to start");
-        attroff(COLOR_PAIR(1)|A_UNDERLINE);
-        refresh();
-        getch();
+    int height(){
+        return h;
     }
 
-    void drawGameOver(){
+    //the window is the whole world
+    bool whole(){
+        return w == worldw && h == worldh;
+    }
+
+    //move the window over p, call before setBody()
+    void center(Position p){
+        ox = centerView(p.first, w, worldw);
+        oy = centerView(p.second, h, worldh);
+    }
+
+    //the nearest cell to p inside the window
+    Position clamp(Position p){
+        int x = max(max(ox, 1), min(p.first, min(ox+w, worldw-1)-1));
+        int y = max(max(oy, 1), min(p.second, min(oy+h, worldh-1)-1));
+        return make_pair(x, y);
+    }
+
+    int index(Position p){
+        return (p.second-oy)*w+p.first-ox;
+    }
+
+    Position position(int idx){
+        return make_pair(idx%w+ox, idx/w+oy);
+    }
+
+    bool isWall(Position p){
+        return p.first <= 0 || p.first >= worldw-1 || p.second <= 0 || p.second >= worldh-1 ||
+               p.first < ox || p.first >= ox+w || p.second < oy || p.second >= oy+h;
+    }
+
+    //body[0] is head, body[i] is free after size-i ticks(one more if the snake is growing)
+    void setBody(const vector<Position>& body, int growing = 0){
+        curfree++;
+        int n = body.size();
+        for(int i=0;i<n;i++){
+            if(!inside(body[i]))
+                continue;
+            int idx = index(body[i]);
+            int t = n-i+growing;
+            if(freestamp[idx] != curfree || freeat[idx] < t){
+                freestamp[idx] = curfree;
+                freeat[idx] = t;
+            }
+        }
+    }
+
+    void block(Position p){
+        if(isWall(p))
+            return;
+        int idx = index(p);
+        freestamp[idx] = curfree;
+        freeat[idx] = BLOCKED;
+    }
+
+    int freeAt(Position p){
+        if(!inside(p))
+            return 0;
+        int idx = index(p);
+        return freestamp[idx] == curfree ? freeat[idx] : 0;
+    }
+
+    bool passable(Position p, int t){
+        return !isWall(p) && freeAt(p) <= t;
+    }
+
+    //A* from start to goal, path excludes start. return false if not found in budget nodes
+    bool findPath(Position start, Position goal, vector<Position>& path, int budget){
+        path.clear();
+        if(isWall(goal))
+            return false;
+        curvisit++;
+        priority_queue<Node, vector<Node>, greater<Node> > open;
+        int s = index(start), g = index(goal);
+        visitstamp[s] = curvisit;
+        dist[s] = 0;
+        from[s] = -1;
+        open.push(Node(manhattan(start, goal), 0, s));
+        while(!open.empty() && budget-- > 0){
+            int cur = open.top().idx;
+            int cost = open.top().g;
+            open.pop();
+            Position p = position(cur);
+            if(cost > dist[cur])
+                continue;   //stale entry
+            if(cur == g){
+                for(int i=g;i!=s;i=from[i])
+                    path.push_back(position(i));
+                reverse(path.begin(), path.end());
+                return true;
+            }
+            for(int d=0;d<4;d++){
+                Position np = neighbor(p, d);
+                int t = dist[cur]+1;
+                if(!passable(np, t))
+                    continue;
+                int ni = index(np);
+                if(visitstamp[ni] == curvisit && dist[ni] <= t)
+                    continue;
+                visitstamp[ni] = curvisit;
+                dist[ni] = t;
+                from[ni] = cur;
+                open.push(Node(t+manhattan(np, goal), t, ni));
+            }
+        }
+        return false;
+    }
+
+    //BFS from start at tick t0, count reachable cells(stop at need), or reach a body cell behind the tail
+    int reachable(Position start, int t0, int need, int budget, bool* touchbody = nullptr){
+        curvisit++;
+        if(touchbody)
+            *touchbody = false;
+        queue<int> q;
+        int s = index(start);
+        visitstamp[s] = curvisit;
+        dist[s] = t0;
+        q.push(s);
+        int count = 1;
+        while(!q.empty() && count < need && count < budget){
+            int cur = q.front();
+            q.pop();
+            Position p = position(cur);
+            for(int d=0;d<4;d++){
+                Position np = neighbor(p, d);
+                int t = dist[cur]+1;
+                if(!passable(np, t))
+                    continue;
+                int ni = index(np);
+                if(visitstamp[ni] == curvisit)
+                    continue;
+                if(touchbody && freeAt(np) > 0){
+                    *touchbody = true;
+                    return count;
+                }
+                visitstamp[ni] = curvisit;
+                dist[ni] = t;
+                q.push(ni);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    static Position neighbor(Position p, int d){
+        static const int dx[4] = {-1, 1, 0, 0};
+        static const int dy[4] = {0, 0, -1, 1};
+        return make_pair(p.first+dx[d], p.second+dy[d]);
+    }
+
+    static int manhattan(Position a, Position b){
+        return abs(a.first-b.first)+abs(a.second-b.second);
+    }
+
+private:
+    //open list node, on equal f the deeper one goes first, or A* floods the whole rectangle
+    struct Node{
+        int f;
+        int g;
+        int idx;
+        Node(int f, int g, int idx):f(f), g(g), idx(idx){}
+        bool operator>(const Node& o) const{
+            return f != o.f ? f > o.f : g < o.g;
+        }
+    };
+
+    int w;  //the window
+    int h;
+    vector<int> freeat;
+    vector<unsigned> freestamp;
+    vector<unsigned> visitstamp;
+    vector<int> dist;
+    vector<int> from;
+    unsigned curfree;
+    unsigned curvisit;
+    int worldw;
+    int worldh;
+    int ox; //top-left cell of the window
+    int oy;
+
+    bool inside(Position p){
+        return p.first >= ox && p.first < ox+w && p.second >= oy && p.second < oy+h;
+    }
+};
+
+const int PathFinder::MAX_WINDOW;
+
+//class AutoController, the autopilot
+/*
+decide order:
+    1. reuse the planned path while the food and the head are where we expected.
+    2. A* to food, accept it only if the snake can still escape after eating.
+    3. chase the tail.
+    4. follow the hamiltonian cycle of the board(when the board has one and fits the PathFinder).
+    5. go to the neighbor with the most room.
+*/
+class AutoController : public Controller{
+public:
+    AutoController(int w, int h, Food* food = nullptr, BlackHoleTable* blackholes = nullptr, int budget = 1<<14)
+        :finder(w, h), food(food), blackholes(blackholes), budget(budget){
+        plantarget = make_pair(-1, -1);
+    }
+
+    void control(Snake& snake) override{
+        snake.setDirection(decide(snake, food->getPos()));
+    }
+
+    Direction decide(Snake& snake, Position target){
+        const vector<Position>& body = snake.getBody();
+        Position head = body[0];
+        if(!plan.empty() && target == plantarget && head == plannedhead && !isBlackHole(plan.back()))
+            return follow(head);
+        plan.clear();
+        plantarget = target;
+        if(!finder.whole()){
+            finder.center(head);
+            target = finder.clamp(target);  //far food: go to the edge of the window first
+        }
+
+        //the head is on the food: the snake grows this tick and the food moves away
+        int growing = head == plantarget ? 1 : 0;
+        finder.setBody(body, growing);
+        blockBlackHoles();
+        if(!growing && finder.findPath(head, target, path, budget) && safeAfter(body, path)){
+            plan.assign(path.rbegin(), path.rend());
+            return follow(head);
+        }
+
+        finder.setBody(body, growing);
+        blockBlackHoles();
+        Position next;
+        if(chaseTail(body, next) || followCycle(body, next) || mostRoom(body, next)){
+            plannedhead = next;
+            return toDirection(head, next);
+        }
+        return snake.getDirection();    //nowhere to go
+    }
+
+    //row 0 goes right, then zigzag over column 1..w-1, and column 0 goes back up. h must be even
+    static Position cycleNext(Position p, int w, int h){
+        int x = p.first, y = p.second;
+        if(x == 0)
+            return y == 0 ? make_pair(1, 0) : make_pair(0, y-1);
+        if(y == 0)
+            return x < w-1 ? make_pair(x+1, 0) : make_pair(x, 1);
+        if(y%2){
+            if(x > 1)
+                return make_pair(x-1, y);
+            return y == h-1 ? make_pair(0, y) : make_pair(1, y+1);
+        }
+        return x < w-1 ? make_pair(x+1, y) : make_pair(x, y+1);
+    }
+
+private:
+    PathFinder finder;
+    Food* food;
+    BlackHoleTable* blackholes;
+    int budget;
+    vector<Position> plan;  //reversed, plan.back() is the next cell
+    vector<Position> path;
+    vector<Position> virtualbody;
+    Position plantarget;
+    Position plannedhead;
+
+    Direction follow(Position head){
+        Position next = plan.back();
+        plan.pop_back();
+        plannedhead = next;
+        return toDirection(head, next);
+    }
+
+    static Direction toDirection(Position from, Position to){
+        if(to.first < from.first)
+            return LEFT;
+        if(to.first > from.first)
+            return RIGHT;
+        if(to.second < from.second)
+            return TOP;
+        return BOTTOM;
+    }
+
+    bool isBlackHole(Position p){
+        return blackholes && blackholes->isBlackHole(p);
+    }
+
+    void blockBlackHoles(){
+        if(!blackholes || !blackholes->isShow())
+            return;
+        for(auto& pair : blackholes->getPairs())
+            if(pair.uses > 0){
+                finder.block(pair.end[0]);
+                finder.block(pair.end[1]);
+            }
+    }
+
+    //can the snake, grown by one at the end of path, still reach its tail or enough room
+    bool safeAfter(const vector<Position>& body, const vector<Position>& path){
+        size_t n = body.size()+1;
+        virtualbody.clear();
+        for(int i=(int)path.size()-1;i>=0 && virtualbody.size()<n;i--)
+            virtualbody.push_back(path[i]);
+        for(size_t i=0;i<body.size() && virtualbody.size()<n;i++)
+            virtualbody.push_back(body[i]);
+        if(virtualbody.size() < n)
+            virtualbody.push_back(virtualbody.back());
+        finder.setBody(virtualbody);
+        blockBlackHoles();
+        bool touchbody;
+        int room = finder.reachable(virtualbody[0], 0, budget, budget, &touchbody);
+        return touchbody || room >= budget;
+    }
+
+    bool safeStep(const vector<Position>& body, Position next){
+        if(next == body[1] || !finder.passable(next, 1))
+            return false;
+        bool touchbody;
+        int room = finder.reachable(next, 1, budget, budget, &touchbody);
+        return touchbody || room >= budget;
+    }
+
+    //take the safe step farthest from the food, the snake follows its tail until food is safe
+    bool chaseTail(const vector<Position>& body, Position& next){
+        int best = -1;
+        for(int d=0;d<4;d++){
+            Position np = PathFinder::neighbor(body[0], d);
+            if(!safeStep(body, np))
+                continue;
+            int far = PathFinder::manhattan(np, plantarget);
+            if(far > best){
+                best = far;
+                next = np;
+            }
+        }
+        return best >= 0;
+    }
+
+    //interior is (w-2)x(h-2), the cycle exists when one of the sides is even
+    bool followCycle(const vector<Position>& body, Position& next){
+        int iw = finder.width()-2, ih = finder.height()-2;
+        if(!finder.whole() || iw < 2 || ih < 2 || (iw%2 && ih%2))
+            return false;
+        Position p = make_pair(body[0].first-1, body[0].second-1);
+        if(ih%2 == 0)
+            p = cycleNext(p, iw, ih);
+        else{
+            p = cycleNext(make_pair(p.second, p.first), ih, iw);
+            p = make_pair(p.second, p.first);
+        }
+        next = make_pair(p.first+1, p.second+1);
+        return safeStep(body, next);
+    }
+
+    //most room first, then hug walls and body so the free space stays in one piece
+    bool mostRoom(const vector<Position>& body, Position& next){
+        int best = -1, besthug = -1;
+        for(int d=0;d<4;d++){
+            Position np = PathFinder::neighbor(body[0], d);
+            if(np == body[1] || !finder.passable(np, 1))
+                continue;
+            int room = finder.reachable(np, 1, budget, budget);
+            int hug = 0;
+            for(int k=0;k<4;k++)
+                if(!finder.passable(PathFinder::neighbor(np, k), 2))
+                    hug++;
+            if(room > best || (room == best && hug > besthug)){
+                best = room;
+                besthug = hug;
+                next = np;
+            }
+        }
+        return best >= 0;
+    }
+};
+
+//class Recording, a game is its seed plus the ticks the direction changed.
+/*
+file format(little endian):
+    "SNKR", u8 version, u64 seed, u16 width, u16 height, u16 black hole pairs(since version 2),
+    varint count, count x varint((tick delta)<<2 | direction),
+    varint ticks, varint score
+*/
+class Recording{
+public:
+    struct Change{
+        long long tick;
+        Direction direction;
+    };
+
+    Recording(){
+        reset(0, 0, 0);
+    }
+
+    void reset(uint64_t seed, int w, int h, int pairs = 1){
+        this->seed = seed;
+        this->w = w;
+        this->h = h;
+        this->pairs = pairs;
+        changes.clear();
+        last = LEFT;
+        ticks = 0;
+        score = 0;
+    }
+
+    void note(long long tick, Direction direction){
+        if(direction == last)
+            return;
+        Change change = {tick, direction};
+        changes.push_back(change);
+        last = direction;
+    }
+
+    void finish(long long ticks, int score){
+        this->ticks = ticks;
+        this->score = score;
+    }
+
+    bool save(const string& filename){
+        vector<unsigned char> buf(MAGIC, MAGIC+4);
+        buf.push_back(VERSION);
+        putFixed(buf, seed, 8);
+        putFixed(buf, w, 2);
+        putFixed(buf, h, 2);
+        putFixed(buf, pairs, 2);
+        putVarint(buf, changes.size());
+        long long prev = 0;
+        for(auto& change : changes){
+            putVarint(buf, (uint64_t(change.tick-prev)<<2)|change.direction);
+            prev = change.tick;
+        }
+        putVarint(buf, ticks);
+        putVarint(buf, score);
+        FILE* file = fopen(filename.c_str(), "wb");
+        if(!file)
+            return false;
+        bool ok = fwrite(buf.data(), 1, buf.size(), file) == buf.size();
+        fclose(file);
+        return ok;
+    }
+
+    bool load(const string& filename){
+        FILE* file = fopen(filename.c_str(), "rb");
+        if(!file)
+            return false;
+        vector<unsigned char> buf;
+        unsigned char chunk[4096];
+        size_t n;
+        while((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            buf.insert(buf.end(), chunk, chunk+n);
+        fclose(file);
+
+        size_t at = 0;
+        if(buf.size() < 17 || !equal(MAGIC, MAGIC+4, buf.begin()) || buf[4] < 1 || buf[4] > VERSION)
+            return false;
+        int version = buf[4];
+        at = 5;
+        uint64_t seed = getFixed(buf, at, 8);
+        int w = getFixed(buf, at, 2);
+        int h = getFixed(buf, at, 2);
+        if(w < 3 || h < 3 || w > MAX_BOARD || h > MAX_BOARD)
+            return false;
+        int pairs = 1;
+        if(version >= 2){
+            if(buf.size() < at+2)
+                return false;
+            pairs = getFixed(buf, at, 2);
+        }
+        reset(seed, w, h, pairs);
+        uint64_t count;
+        if(!getVarint(buf, at, count))
+            return false;
+        long long tick = 0;
+        for(uint64_t i=0;i<count;i++){
+            uint64_t v;
+            if(!getVarint(buf, at, v))
+                return false;
+            tick += v>>2;
+            note(tick, Direction(v&3));
+        }
+        uint64_t t, sc;
+        if(!getVarint(buf, at, t) || !getVarint(buf, at, sc))
+            return false;
+        finish(t, sc);
+        return true;
+    }
+
+    uint64_t seed;
+    int w;
+    int h;
+    int pairs;
+    vector<Change> changes;
+    long long ticks;
+    int score;
+
+private:
+    static const unsigned char MAGIC[4];
+    static const unsigned char VERSION = 2;
+    Direction last;
+
+    static void putFixed(vector<unsigned char>& buf, uint64_t v, int bytes){
+        for(int i=0;i<bytes;i++)
+            buf.push_back((v>>(8*i))&0xff);
+    }
+
+    static uint64_t getFixed(const vector<unsigned char>& buf, size_t& at, int bytes){
+        uint64_t v = 0;
+        for(int i=0;i<bytes;i++)
+            v |= uint64_t(buf[at++])<<(8*i);
+        return v;
+    }
+
+    static void putVarint(vector<unsigned char>& buf, uint64_t v){
+        while(v >= 0x80){
+            buf.push_back((v&0x7f)|0x80);
+            v >>= 7;
+        }
+        buf.push_back(v);
+    }
+
+    static bool getVarint(const vector<unsigned char>& buf, size_t& at, uint64_t& v){
+        v = 0;
+        for(int shift=0;at<buf.size() && shift<64;shift+=7){
+            unsigned char b = buf[at++];
+            v |= uint64_t(b&0x7f)<<shift;
+            if(!(b&0x80))
+                return true;
+        }
+        return false;
+    }
+};
+
+const unsigned char Recording::MAGIC[4] = {'S', 'N', 'K', 'R'};
+const unsigned char Recording::VERSION;
+
+//class ReplayController, turn the snake at the recorded ticks
+class ReplayController : public Controller{
+public:
+    ReplayController(const Recording& rec):rec(rec){
+        tick = 0;
+        next = 0;
+    }
+
+    void control(Snake& snake) override{
+        while(next < rec.changes.size() && rec.changes[next].tick <= tick)
+            snake.setDirection(rec.changes[next++].direction);
+        tick++;
+    }
+private:
+    const Recording& rec;
+    long long tick;
+    size_t next;
+};
+
+//class GameState, the rules of one game. No ncurses here, so it can run headless
+class GameState{
+public:
+    static const int BLACK_HOLE_USES = 4;
+
+    GameState(){
+        timecount = 0;
+        teleports = 0;
+        recording = nullptr;
+    }
+
+    //begin a game on a w x h board with pairs of black holes, everything random comes from seed
+    void start(int w, int h, uint64_t seed, int pairs = 1){
+        boardw = w;
+        boardh = h;
+        isgameover = false;
+        timecount = 0;
+        teleports = 0;
+        random.seed(seed);
+        snake.init(&score);
+        blackholes.reset(pairs, BLACK_HOLE_USES);
+        food.init(&snake, &random, &blackholes);
+        food.changePos();
+        blackholes.init(&snake, &food, &random);
+        blackholes.place();
+        colsystem.clear();
+        colsystem.add(&snake);
+        colsystem.add(&food);
+        colsystem.add(&blackholes);
+        if(recording)
+            recording->reset(seed, w, h, pairs);
+    }
+
+    //record direction changes into rec from now on, call before start
+    void record(Recording* rec){
+        recording = rec;
+    }
+
+    //one tick of the game
+    void tick(Controller& controller){
+        PROFILE_PHASE("tick");
+        {
+            PROFILE_PHASE("control");
+            controller.control(snake);
+        }
+        if(recording)
+            recording->note(timecount, snake.getDirection());
+        {
+            PROFILE_PHASE("collisionTest");
+            collisionTest();
+        }
+        {
+            PROFILE_PHASE("updates");
+            updates();
+        }
+        timecount++;
+        if(recording && isgameover)
+            recording->finish(timecount, score.getScore());
+    }
+
+    void collisionTest(){
+        Position head = snake.getPos();
+        colsystem.detect();
+        if(snake.getPos() != head)
+            teleports++;
+        snake.collisionBorder();
+    }
+
+    void updates(){
+        snake.step();
+        if(timecount >= 500)
+            blackholes.show();
+    }
+
+    int getScore(){
+        return score.getScore();
+    }
+
+    long long getTicks(){
+        return timecount;
+    }
+
+    int getTeleports(){
+        return teleports;
+    }
+
+    //print the board around the head(at most MAX_DUMP cells wide), the same chars as ncurses draws
+    void dump(FILE* out){
+        int vw = min(boardw, MAX_DUMP), vh = min(boardh, MAX_DUMP);
+        Position head = snake.getPos();
+        Position view = make_pair(centerView(head.first, vw, boardw), centerView(head.second, vh, boardh));
+        vector<string> rows(vh, string(vw, ' '));
+        for(int x=0;x<boardw;x++){
+            put(rows, view, make_pair(x, 0), '-');
+            put(rows, view, make_pair(x, boardh-1), '-');
+        }
+        for(int y=0;y<boardh;y++){
+            put(rows, view, make_pair(0, y), '|');
+            put(rows, view, make_pair(boardw-1, y), '|');
+        }
+        if(blackholes.isShow())
+            for(auto& pair : blackholes.getPairs())
+                if(pair.uses > 0){
+                    put(rows, view, pair.end[0], BlackHoleTable::BLACK_HOLE);
+                    put(rows, view, pair.end[1], BlackHoleTable::BLACK_HOLE);
+                }
+        put(rows, view, food.getPos(), 'D');
+        const vector<Position>& body = snake.getBody();
+        for(int i=body.size()-1;i>=0;i--)
+            put(rows, view, body[i], i == 0 ? '@' : 'S');
+        fprintf(out, "tick %lld, score %d%s\n", timecount, score.getScore(), isgameover ? ", game over" : "");
+        if(vw < boardw || vh < boardh)
+            fprintf(out, "cells %d..%d x %d..%d of %dx%d\n", view.first, view.first+vw-1,
+                    view.second, view.second+vh-1, boardw, boardh);
+        for(auto& row : rows)
+            fprintf(out, "%s\n", row.c_str());
+    }
+
+protected:
+    long long timecount;
+    int teleports;
+    Random random;
+    Recording* recording;
+    Snake snake;
+    Food food;
+    Score score;
+    BlackHoleTable blackholes;
+    CollisionSystem colsystem;
+
+    static const int MAX_DUMP = 200;
+
+    static void put(vector<string>& rows, Position view, Position p, char c){
+        int x = p.first-view.first, y = p.second-view.second;
+        if(y >= 0 && y < int(rows.size()) && x >= 0 && x < int(rows[y].size()))
+            rows[y][x] = c;
+    }
+};
+
+const int GameState::MAX_DUMP;
+
+//class GameMain, the ncurses game
+/*
+The world is the terminal by default, a larger one(up to MAX_BOARD x MAX_BOARD) scrolls: the
+camera follows the head and only the cells on the screen are drawn.
+The simulation only keeps the body bitmap of Snake, w*h/8 bytes, nothing is sized by the terminal.
+*/
+class GameMain : public GameState{
+public:
+    //w x h is the world, 0 for the size of the terminal
+    GameMain(uint64_t seed, bool autopilot = false, Recording* rec = nullptr, int w = 0, int h = 0, int pairs = 1){
+        init_config();
+        init_color();
+        bool nocolor = isgameover;
+        record(rec);
+        start(w > 0 ? w : COLS, h > 0 ? h : LINES, seed, pairs);
+        isgameover = nocolor;
+        keyboard = nullptr;
+        if(autopilot)
+            controller.reset(new AutoController(boardw, boardh, &food, &blackholes));
+        else
+            controller.reset(keyboard = new KeyboardController(&input.getQueue()));
+    }
+
+    void init_color(){
+        init_pair(1, COLOR_GREEN, COLOR_BLACK);     //text color, score color
+        init_pair(2, COLOR_BLUE, COLOR_BLACK);      //food color
+        init_pair(3, COLOR_YELLOW, COLOR_BLACK);    //snake color
+        init_pair(4, COLOR_RED, COLOR_BLACK);       //game over text
+        init_pair(5, COLOR_MAGENTA, COLOR_WHITE);   //black hole
+    }
+
+    void init_config(){
+        isgameover = false;
+        initscr();
+        if(has_colors() == FALSE){
+            endwin();
+            isgameover = true;
+        }
+        start_color();
+        curs_set(0);
+        cbreak();
+        noecho();
+        keypad(stdscr, TRUE);
+        //srand(time(nullptr));
+    }
+
+    //tick first and draw after, so a turn is on the screen in the same frame
+    void drawGameBody(){
+        PROFILE_PHASE("frame");
+        clear();
+        tick(*controller);
+        {
+            PROFILE_PHASE("drawItems");
+            drawItems();
+        }
+        #ifdef DEBUG_SNAKE
+        mvprintw(LINES-1, 0, "count:%d", countnum++);
+        #endif
+        {
+            PROFILE_PHASE("refresh");
+            refresh();
+        }
+        chrono::steady_clock::time_point keytime;
+        if(keyboard && keyboard->lastTurn(keytime))
+            latencies.push_back(chrono::duration<double, milli>(chrono::steady_clock::now()-keytime).count());
+    }
+
+    void drawItems(){
+        Position head = snake.getPos();
+        camera = make_pair(centerView(head.first, COLS, boardw), centerView(head.second, LINES, boardh));
+        drawWalls();
+        score.draw();
+        food.draw();
+        drawFoodMarker();
+        snake.draw();
+        blackholes.draw();
+    }
+
+    //the border of the world, where it's on the screen
+    void drawWalls(){
+        int left = -camera.first, top = -camera.second;
+        int right = boardw-1-camera.first, bottom = boardh-1-camera.second;
+        int x0 = max(left, 0), x1 = min(right, COLS-1);
+        int y0 = max(top, 0), y1 = min(bottom, LINES-1);
+        if(top >= 0 && top < LINES)
+            mvhline(top, x0, ACS_HLINE, x1-x0+1);
+        if(bottom >= 0 && bottom < LINES)
+            mvhline(bottom, x0, ACS_HLINE, x1-x0+1);
+        if(left >= 0 && left < COLS)
+            mvvline(y0, left, ACS_VLINE, y1-y0+1);
+        if(right >= 0 && right < COLS)
+            mvvline(y0, right, ACS_VLINE, y1-y0+1);
+        drawCell(make_pair(0, 0), ACS_ULCORNER);
+        drawCell(make_pair(boardw-1, 0), ACS_URCORNER);
+        drawCell(make_pair(0, boardh-1), ACS_LLCORNER);
+        drawCell(make_pair(boardw-1, boardh-1), ACS_LRCORNER);
+    }
+
+    //food off the screen is pointed at from the edge of the screen
+    void drawFoodMarker(){
+        Position p = food.getPos();
+        int x = p.first-camera.first, y = p.second-camera.second;
+        if(x >= 0 && x < COLS && y >= 0 && y < LINES)
+            return;
+        attron(COLOR_PAIR(2)|A_BOLD);
+        mvaddch(max(1, min(y, LINES-2)), max(1, min(x, COLS-2)), '+');
+        attroff(COLOR_PAIR(2)|A_BOLD);
+    }
+
+    void drawWelcome(){
+        clear();
+        box(stdscr, 0, 0);
+        attron(A_BOLD);
+        mvprintw(LINES/2-1, COLS/2-5, "snake game");
+        attroff(A_BOLD);
+        attron(COLOR_PAIR(1)|A_UNDERLINE);
+        mvprintw(LINES/2, COLS/2-11, "press any key to start");
+        attroff(COLOR_PAIR(1)|A_UNDERLINE);
+        refresh();
+        getch();
+    }
+
+    void drawGameOver(){
         clear();
         cbreak();
         box(stdscr, 0, 0);
@@ -554,16 +1983,32 @@ public:
         mvprintw(LINES/2, COLS/2-8, "your score is:%d", score);
         attroff(COLOR_PAIR(1)|A_UNDERLINE);
         mvprintw(LINES/2+1, COLS/2-7, "press q to exit");
+        if(!latencies.empty()){
+            double sum = 0, worst = 0;
+            for(double ms : latencies){
+                sum += ms;
+                worst = max(worst, ms);
+            }
+            mvprintw(LINES/2+2, COLS/2-17, "input latency avg %.0fms, max %.0fms", sum/latencies.size(), worst);
+        }
         refresh();
         while(getch() != 'q');
     }
 
+    //fixed timestep on the monotonic clock, input arrives through the InputReader
     void gameloop(){
-        halfdelay(DELAY_TIME);
+        const chrono::steady_clock::duration period = chrono::milliseconds(DELAY_TIME*100);
+        input.start();
+        chrono::steady_clock::time_point next = chrono::steady_clock::now();
         while(!isgameover){
+            this_thread::sleep_until(next);
             drawGameBody();
-            timecount++;
+            next += period;
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if(now > next+period)
+                next = now; //too far behind(e.g. suspended), don't run a burst of ticks
         }
+        input.stop();
     }
 
     void run(){
@@ -576,19 +2021,824 @@ public:
         endwin();
     }
 private:
-    static const int DELAY_TIME = 5;
-    long long timecount;
-    Snake snake;
-    Food food;
-    Score score;
-    BHGroup bhgroup;
-    Controller controller;
-    CollisionSystem colsystem;
+    static const int DELAY_TIME = 5;  //tenths of a second per tick
+    InputReader input;
+    KeyboardController* keyboard;   //owned by controller, null for autopilot
+    unique_ptr<Controller> controller;
+    vector<double> latencies;   //ms from key press to the frame showing the turn
+};
+
+//class SelfPlay, the autopilot plays one GameState headless
+class SelfPlay : public GameState{
+public:
+    struct Result{
+        int score;
+        long long ticks;
+        int teleports;
+        bool capped;    //stopped by maxticks, still alive
+    };
+
+    SelfPlay(){}
+
+    Result play(int w, int h, uint64_t seed, long long maxticks, int pairs = 1){
+        start(w, h, seed, pairs);
+        AutoController autopilot(w, h, &food, &blackholes);
+        int full = (w-2)*(h-2);
+        while(!isgameover && timecount < maxticks && snake.size() < full)
+            tick(autopilot);
+        Result result = {score.getScore(), timecount, teleports,
+                         !isgameover && snake.size() < full && timecount >= maxticks};
+        return result;
+    }
 };
 
+//class BatchRunner, run many self-play games on all cores
+class BatchRunner{
+public:
+    BatchRunner(int w, int h, long long maxticks, uint64_t seed, int pairs = 1)
+        :w(w), h(h), maxticks(maxticks), seed(seed), pairs(pairs){}
+
+    //game i always uses seed+i, so results don't depend on the thread count
+    vector<SelfPlay::Result> run(int games, int threads){
+        vector<SelfPlay::Result> results(games);
+        atomic<int> next(0);
+        vector<thread> workers;
+        for(int t=0;t<threads;t++)
+            workers.push_back(thread([&](){
+                int i;
+                while((i = next++) < games){
+                    SelfPlay game;
+                    results[i] = game.play(w, h, seed+i, maxticks, pairs);
+                }
+            }));
+        for(auto& worker : workers)
+            worker.join();
+        return results;
+    }
+
+    //a game stopped by maxticks only gives a lower bound of its ticks, those are counted apart
+    static void report(vector<SelfPlay::Result>& results){
+        int n = results.size();
+        vector<int> scores, teleports;
+        vector<long long> ticks;
+        int usedbh = 0, capped = 0;
+        for(auto& r : results){
+            scores.push_back(r.score);
+            if(r.capped)
+                capped++;
+            else
+                ticks.push_back(r.ticks);
+            teleports.push_back(r.teleports);
+            if(r.teleports > 0)
+                usedbh++;
+        }
+        sort(scores.begin(), scores.end());
+        sort(ticks.begin(), ticks.end());
+        sort(teleports.begin(), teleports.end());
+        printf("%-10s %10s %10s %10s %10s %10s %10s\n", "", "mean", "min", "p50", "p90", "p99", "max");
+        printf("%-10s %10.2f %10d %10d %10d %10d %10d\n", "score", mean(scores),
+               scores[0], percentile(scores, 50), percentile(scores, 90), percentile(scores, 99), scores[n-1]);
+        if(!ticks.empty())
+            printf("%-10s %10.2f %10lld %10lld %10lld %10lld %10lld\n", "ticks", mean(ticks), ticks[0],
+                   percentile(ticks, 50), percentile(ticks, 90), percentile(ticks, 99), ticks.back());
+        //AutoController walls the black holes off(its room searches can't follow a teleport)
+        if(usedbh > 0){
+            printf("%-10s %10.2f %10d %10d %10d %10d %10d\n", "teleports", mean(teleports), teleports[0],
+                   percentile(teleports, 50), percentile(teleports, 90), percentile(teleports, 99), teleports[n-1]);
+            printf("black hole used in %d of %d games(%.1f%%)\n", usedbh, n, 100.0*usedbh/n);
+        }else
+            printf("no black hole used, the autopilot keeps off them\n");
+        printf("%d of %d games still alive at --max-ticks, the ticks row only counts the others\n", capped, n);
+
+        //score histogram, 10 buckets
+        int lo = scores[0], hi = scores[n-1];
+        int step = max(1, (hi-lo+10)/10);
+        printf("score distribution:\n");
+        for(int b=lo;b<=hi;b+=step){
+            int count = upper_bound(scores.begin(), scores.end(), b+step-1) - lower_bound(scores.begin(), scores.end(), b);
+            printf("  [%5d, %5d] %7d %s\n", b, b+step-1, count, string(count*50/n, '#').c_str());
+        }
+    }
+
+private:
+    int w;
+    int h;
+    long long maxticks;
+    uint64_t seed;
+    int pairs;
+
+    template <typename T>
+    static double mean(const vector<T>& v){
+        double sum = 0;
+        for(auto& x : v)
+            sum += x;
+        return sum/v.size();
+    }
+
+    template <typename T>
+    static T percentile(const vector<T>& sorted, int p){
+        return sorted[min<size_t>(sorted.size()-1, sorted.size()*p/100)];
+    }
+};
+
+//batch mode: statistics of the full run, then games/sec for 1, 2, 4 ... threads
+void runBatch(int games, int threads, int w, int h, long long maxticks, uint64_t seed, int pairs){
+    BatchRunner runner(w, h, maxticks, seed, pairs);
+    printf("%d games on %dx%d board, %d black hole pairs, at most %lld ticks, seed %llu, %d threads\n",
+           games, w, h, pairs, maxticks, (unsigned long long)seed, threads);
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    vector<SelfPlay::Result> results = runner.run(games, threads);
+    double sec = chrono::duration<double>(chrono::steady_clock::now()-begin).count();
+    BatchRunner::report(results);
+    printf("%.2f s, %.1f games/sec\n\n", sec, games/sec);
+
+    //scaling, on a slice of the games so the sweep doesn't take forever
+    int slice = max(1, min(games, 200*threads));
+    printf("%-8s %12s %10s %11s\n", "threads", "games/sec", "speedup", "efficiency");
+    double base = 0;
+    for(int t=1;;t=min(t*2, threads)){
+        begin = chrono::steady_clock::now();
+        runner.run(slice, t);
+        double rate = slice/chrono::duration<double>(chrono::steady_clock::now()-begin).count();
+        if(t == 1)
+            base = rate;
+        printf("%-8d %12.1f %10.2f %10.1f%%\n", t, rate, rate/base, 100.0*rate/base/t);
+        if(t == threads)
+            break;
+    }
+}
+
+//class Arena, many AI snakes on one board, stored struct-of-arrays.
+/*
+A cell is y*w+x. The bodies are ring buffers(head first) in one shared array, snake i owns
+ring[i*cap, (i+1)*cap). occ holds owner+1 of every body cell and -1 on the border, so a
+head needs one lookup to know if it hits something.
+All snakes move at once: tails leave first, then every head is checked against the bodies
+(head-to-body) and against the other new heads(head-to-head). Dead snakes leave the board.
+The AI is greedy on purpose(nearest food, no dead ends), it has to be cheap for hundreds of snakes.
+*/
+class Arena{
+public:
+    Arena(int w, int h, int snakes, int foods, int maxlen, uint64_t seed)
+        :w(w), h(h), n(snakes), cap(maxlen), random(seed),
+         ring(snakes*maxlen), start(snakes, 0), length(snakes, 0), grow(snakes, 0), dir(snakes, LEFT),
+         score(snakes, 0), target(snakes, -1), targetcell(snakes, -1), deathtick(snakes, -1), alive(snakes, 0),
+         occ(w*h, 0), foodat(w*h, 0), heads(w*h, 0), headstamp(w*h, 0), nexthead(snakes, 0), dying(snakes, 0){
+        delta[LEFT] = -1;
+        delta[RIGHT] = 1;
+        delta[TOP] = -w;
+        delta[BOTTOM] = w;
+        stamp = 0;
+        ticks = 0;
+        moves = 0;
+        living = 0;
+        for(int x=0;x<w;x++)
+            occ[x] = occ[(h-1)*w+x] = -1;
+        for(int y=0;y<h;y++)
+            occ[y*w] = occ[y*w+w-1] = -1;
+        for(int i=0;i<n;i++){
+            int cell = randomFreeCell();
+            if(cell < 0)
+                break;
+            alive[i] = 1;
+            living++;
+            length[i] = 1;
+            grow[i] = 2;
+            ring[i*cap] = cell;
+            occ[cell] = i+1;
+            dir[i] = Direction(random.getInt()%4);
+        }
+        for(int i=0;i<foods;i++){
+            int cell = randomFreeCell();
+            if(cell < 0)
+                break;
+            foodat[cell] = i+1;
+            this->foods.push_back(cell);
+        }
+    }
+
+    void tick(){
+        steer();
+        move();
+        ticks++;
+    }
+
+    bool isOver(){
+        return living <= 1;
+    }
+
+    long long getTicks(){
+        return ticks;
+    }
+
+    int getLiving(){
+        return living;
+    }
+
+    //draw the arena with ncurses, every snake takes one of the colors 1-6
+    void draw(){
+        for(int i=0;i<n;i++){
+            if(!alive[i])
+                continue;
+            attron(COLOR_PAIR(i%6+1));
+            for(int k=0;k<length[i];k++){
+                int cell = ring[i*cap+(start[i]+k)%cap];
+                mvaddch(cell/w, cell%w, k == 0 ? '@' : 'S');
+            }
+            attroff(COLOR_PAIR(i%6+1));
+        }
+        for(int cell : foods)
+            if(cell >= 0)
+                mvaddch(cell/w, cell%w, 'D');
+        mvprintw(h, 0, "tick %lld, %d snakes alive", ticks, living);   //the row under the board
+    }
+
+    void report(double sec){
+        vector<int> order;
+        for(int i=0;i<n;i++)
+            order.push_back(i);
+        sort(order.begin(), order.end(), [this](int a, int b){
+            if(score[a] != score[b])
+                return score[a] > score[b];
+            return survived(a) > survived(b);
+        });
+        printf("%d snakes, %zu foods on %dx%d board, %lld ticks, %d alive\n", n, foods.size(), w, h, ticks, living);
+        printf("%.3f s, %.0f ticks/sec, %.0f snake-ticks/sec\n", sec, ticks/max(sec, 1e-9), moves/max(sec, 1e-9));
+        printf("%-6s %-6s %8s %8s %10s\n", "rank", "snake", "score", "length", "survived");
+        for(int r=0;r<min(n, 10);r++){
+            int i = order[r];
+            printf("%-6d %-6d %8d %8d %10lld%s\n", r+1, i, score[i], alive[i] ? length[i] : 0, survived(i), alive[i] ? " alive" : "");
+        }
+    }
+
+private:
+    int w;
+    int h;
+    int n;
+    int cap;
+    Random random;
+    int delta[4];
+
+    //per snake
+    vector<int> ring;
+    vector<int> start;
+    vector<int> length;
+    vector<int> grow;
+    vector<int> dir;
+    vector<int> score;
+    vector<int> target;
+    vector<int> targetcell;
+    vector<long long> deathtick;
+    vector<unsigned char> alive;
+
+    //per cell
+    vector<int> occ;
+    vector<int> foodat;
+    vector<int> heads;  //new heads on the cell in this tick
+    vector<unsigned> headstamp;
+
+    vector<int> foods;
+    vector<int> nexthead;
+    vector<unsigned char> dying;
+    unsigned stamp;
+    long long ticks;
+    long long moves;
+    int living;
+
+    long long survived(int i){
+        return deathtick[i] < 0 ? ticks : deathtick[i];
+    }
+
+    int head(int i){
+        return ring[i*cap+start[i]];
+    }
+
+    int randomFreeCell(){
+        for(int tries=0;tries<w*h;tries++){
+            int cell = random.getRange(h, 1)*w+random.getRange(w, 1);
+            if(occ[cell] == 0 && foodat[cell] == 0)
+                return cell;
+        }
+        return -1;
+    }
+
+    int distance(int a, int b){
+        return abs(a%w-b%w)+abs(a/w-b/w);
+    }
+
+    void retarget(int i){
+        int hd = head(i), best = INT_MAX;
+        target[i] = -1;
+        for(size_t f=0;f<foods.size();f++){
+            if(foods[f] < 0)
+                continue;
+            int d = distance(hd, foods[f]);
+            if(d < best){
+                best = d;
+                target[i] = f;
+            }
+        }
+        targetcell[i] = target[i] < 0 ? -1 : foods[target[i]];
+    }
+
+    //pick the free neighbor closest to the food, never a dead end if there is a choice
+    void steer(){
+        for(int i=0;i<n;i++){
+            if(!alive[i])
+                continue;
+            if(target[i] < 0 || foods[target[i]] != targetcell[i])
+                retarget(i);
+            int hd = head(i), goal = targetcell[i];
+            int best = -1, bestcost = INT_MAX;
+            for(int d=0;d<4;d++){
+                if(d == (dir[i]^1))
+                    continue;   //no turning back
+                int c = hd+delta[d];
+                if(occ[c])
+                    continue;
+                int blocked = 0;
+                for(int k=0;k<4;k++)
+                    blocked += occ[c+delta[k]] != 0;
+                int cost = (goal < 0 ? 0 : distance(c, goal))+(blocked >= 3 ? 1000 : 0);
+                if(cost < bestcost){
+                    bestcost = cost;
+                    best = d;
+                }
+            }
+            if(best >= 0)
+                dir[i] = best;
+        }
+    }
+
+    void move(){
+        //tails leave first, so a head may enter a cell freed in this tick
+        stamp++;
+        for(int i=0;i<n;i++){
+            if(!alive[i])
+                continue;
+            if(grow[i] > 0 && length[i] < cap)
+                grow[i]--;
+            else{
+                int tail = ring[i*cap+(start[i]+length[i]-1)%cap];
+                occ[tail] = 0;
+                length[i]--;
+            }
+            int next = head(i)+delta[dir[i]];
+            nexthead[i] = next;
+            if(headstamp[next] != stamp){
+                headstamp[next] = stamp;
+                heads[next] = 0;
+            }
+            heads[next]++;
+        }
+        //decide all deaths before removing anyone, everybody moved at the same time
+        for(int i=0;i<n;i++)
+            dying[i] = alive[i] && (occ[nexthead[i]] != 0 || heads[nexthead[i]] > 1);
+        for(int i=0;i<n;i++)
+            if(dying[i])
+                kill(i);
+        for(int i=0;i<n;i++){
+            if(!alive[i])
+                continue;
+            int next = nexthead[i];
+            start[i] = (start[i]+cap-1)%cap;
+            ring[i*cap+start[i]] = next;
+            length[i]++;
+            occ[next] = i+1;
+            moves++;
+            if(foodat[next]){
+                int f = foodat[next]-1;
+                foodat[next] = 0;
+                score[i]++;
+                grow[i]++;
+                foods[f] = randomFreeCell();   //-1, no free cell: the food is gone
+                if(foods[f] >= 0)
+                    foodat[foods[f]] = f+1;
+            }
+        }
+    }
+
+    void kill(int i){
+        alive[i] = 0;
+        living--;
+        deathtick[i] = ticks;
+        for(int k=0;k<length[i];k++){
+            int cell = ring[i*cap+(start[i]+k)%cap];
+            if(occ[cell] == i+1)
+                occ[cell] = 0;
+        }
+        length[i] = 0;
+    }
+};
+
+//random free cell inside a w x h board
+Position randomFreeCell(Random& random, Snake& snake, int w, int h){
+    while(true){
+        Position p = make_pair(random.getRange(w, 1), random.getRange(h, 1));
+        if(!snake.occupies(p))
+            return p;
+    }
+}
+
+//benchmark the autopilot without ncurses: us per decision as the board grows
+void benchAutopilot(){
+    const int sizes[][2] = {{20, 10}, {40, 20}, {80, 40}, {160, 80}, {320, 160}};
+    const int MAX_TICKS = 20000;
+    printf("%-10s %10s %10s %10s %8s\n", "board", "decisions", "avg(us)", "max(us)", "length");
+    for(auto& size : sizes){
+        int w = size[0], h = size[1];
+        boardw = w;
+        boardh = h;
+        Score score;
+        Snake snake;
+        snake.init(&score, make_pair(w/2, h/2));
+        AutoController autopilot(w, h);
+        Random random(w*h);
+        Position food = randomFreeCell(random, snake, w, h);
+        long long decisions = 0;
+        double total = 0, maxus = 0;
+        for(int tick=0;tick<MAX_TICKS;tick++){
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            Direction dir = autopilot.decide(snake, food);
+            double us = chrono::duration<double, micro>(chrono::steady_clock::now()-begin).count();
+            decisions++;
+            total += us;
+            maxus = max(maxus, us);
+            snake.setDirection(dir);
+            if(snake.getPos() == food){
+                snake.addBody(snake.getBody().back());
+                score.increase(1);
+                if(snake.size() >= (w-2)*(h-2))
+                    break;
+                food = randomFreeCell(random, snake, w, h);
+            }
+            if(snake.isDead(w, h))
+                break;
+            snake.step();
+        }
+        char board[32];
+        snprintf(board, sizeof(board), "%dx%d", w, h);
+        printf("%-10s %10lld %10.2f %10.2f %8d\n", board, decisions, total/decisions, maxus, snake.size());
+    }
+}
+
+//time CollisionSystem with virtual and static dispatch on a crowded board
+/*
+A snake winds over the whole board and foods and black holes lie on its body, away from
+the head, so every tick finds the same pairs and nothing moves. Objects counts the foods
+and the black holes, all black holes are one BlackHoleTable(one pair with the snake).
+*/
+void benchCollision(){
+    const int W = 200, H = 60;
+    const int counts[] = {16, 256, 4096};
+    const int TICKS = 300, ROUNDS = 2000;
+    boardw = W;
+    boardh = H;
+    vector<Position> path;
+    for(int y=1;y<H-1;y++)
+        for(int i=1;i<W-1;i++)
+            path.push_back(make_pair(y%2 ? i : W-1-i, y));
+    printf("%-8s %8s %8s %12s %12s %12s %12s\n", "objects", "cells", "pairs",
+           "virtual(us)", "static(us)", "virtual(ns)", "static(ns)");
+    for(int count : counts){
+        Score score;
+        Snake snake;
+        Random random(count);
+        snake.init(&score, path[0]);
+        for(size_t i=2;i<path.size();i++)
+            snake.addBody(path[i]);
+        vector<Food> foods(count/2);
+        BlackHoleTable holes(count/4, 100);
+        CollisionSystem colsystem;
+        colsystem.add(&snake);
+        int stride = (path.size()-1)/count, cell = 1;
+        for(auto& food : foods){
+            food.init(&snake, &random);
+            food.setPos(path[cell]);
+            cell += stride;
+            colsystem.add(&food);
+        }
+        for(int i=0;i<count/4;i++){
+            holes.setPair(i, path[cell], path[cell+stride]);
+            cell += 2*stride;
+        }
+        holes.show();
+        colsystem.add(&holes);
+        double tick[2], pair[2];
+        CollisionSystem::Dispatch modes[2] = {CollisionSystem::VIRTUAL_DISPATCH, CollisionSystem::STATIC_DISPATCH};
+        for(int m=0;m<2;m++){
+            colsystem.setDispatch(modes[m]);
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            for(int i=0;i<TICKS;i++)
+                colsystem.detect();
+            tick[m] = chrono::duration<double, micro>(chrono::steady_clock::now()-begin).count()/TICKS;
+            begin = chrono::steady_clock::now();
+            for(int i=0;i<ROUNDS;i++)
+                colsystem.dispatch();
+            pair[m] = chrono::duration<double, nano>(chrono::steady_clock::now()-begin).count()/ROUNDS/colsystem.getPairs();
+        }
+        assert(snake.size() == int(path.size()) && score.getScore() == 0);
+        printf("%-8d %8d %8d %12.2f %12.2f %12.2f %12.2f\n", count, int(path.size())+count,
+               colsystem.getPairs(), tick[0], tick[1], pair[0], pair[1]);
+    }
+}
+
+//class EngineBench, one game laid out for a case of --bench-engine
+/*
+The snake lies on the hamiltonian cycle of the board and follows it, so it never dies
+however full the board is. There are no black holes except in the teleport case, and the
+tick case never eats(that is food_respawn), so every case keeps its length.
+*/
+class EngineBench : public GameState{
+public:
+    enum Case{STEP, SELF_COLLISION, FOOD_RESPAWN, TELEPORT, TICK, CASE_COUNT};
+
+    static const char* name(Case c){
+        static const char* names[CASE_COUNT] = {"step", "self_collision", "food_respawn", "teleport", "tick"};
+        return names[c];
+    }
+
+    //the snake keeps to the cycle
+    class CycleController : public Controller{
+    public:
+        void control(Snake& snake) override{
+            Position head = snake.getPos();
+            Position next = nextCell(head);
+            if(next.first != head.first)
+                snake.setDirection(next.first < head.first ? LEFT : RIGHT);
+            else
+                snake.setDirection(next.second < head.second ? TOP : BOTTOM);
+        }
+    };
+
+    //a snake of length cells on a w x h board, h-2 must be even
+    void setup(int w, int h, int length, uint64_t seed){
+        start(w, h, seed, 0);
+        vector<Position> cells;
+        Position p = make_pair(1, 1);
+        for(int i=0;i<length;i++){
+            cells.push_back(p);
+            p = nextCell(p);
+        }
+        reverse(cells.begin(), cells.end());
+        snake = Snake();
+        snake.init(&score, cells);
+        food.changePos();
+    }
+
+    //median ns per operation over REPEATS runs of n operations
+    double run(Case c, int n){
+        CycleController cycle;
+        if(c == TELEPORT){
+            blackholes.reset(16, INT_MAX);
+            blackholes.place();
+            blackholes.show();
+            snake.setPos(blackholes.getPairs()[0].end[0]);
+        }
+        if(c == TICK)
+            food.setPos(make_pair(0, 0));   //in the wall, the length stays the same
+        int sink = 0;
+        vector<double> runs;
+        for(int r=0;r<REPEATS;r++){
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            for(int i=0;i<n;i++){
+                switch(c){
+                case STEP:
+                    cycle.control(snake);
+                    snake.step();
+                    break;
+                case SELF_COLLISION:
+                    sink += snake.isDead(boardw, boardh);
+                    break;
+                case FOOD_RESPAWN:
+                    food.changePos();
+                    break;
+                case TELEPORT:
+                    blackholes.hit(snake);
+                    blackholes.settle();
+                    break;
+                default:
+                    tick(cycle);
+                }
+            }
+            runs.push_back(chrono::duration<double, nano>(chrono::steady_clock::now()-begin).count()/n);
+        }
+        assert(!isgameover && sink == 0);
+        sort(runs.begin(), runs.end());
+        return runs[REPEATS/2];
+    }
+
+    int length(){
+        return snake.size();
+    }
+
+private:
+    static const int REPEATS = 5;
+
+    static Position nextCell(Position p){
+        p = AutoController::cycleNext(make_pair(p.first-1, p.second-1), boardw-2, boardh-2);
+        return make_pair(p.first+1, p.second+1);
+    }
+};
+
+//time the per-tick primitives over snake length and board fill, print JSON
+void benchEngine(){
+    const int boards[][2] = {{80, 24}, {320, 120}};
+    const double fills[] = {0.01, 0.1, 0.5, 0.9};
+    const uint64_t SEED = 1;
+    printf("{\n  \"benchmark\": \"snake engine\",\n  \"unit\": \"ns/op\",\n  \"results\": [");
+    bool first = true;
+    for(auto& board : boards)
+        for(double fill : fills){
+            int w = board[0], h = board[1];
+            int length = max(2, int(fill*(w-2)*(h-2)));
+            for(int c=0;c<EngineBench::CASE_COUNT;c++){
+                EngineBench::Case bench = EngineBench::Case(c);
+                int n = 1000000;
+                if(bench == EngineBench::STEP || bench == EngineBench::TICK)
+                    n = max(200, min(20000, 20000000/(length+1000)));
+                else if(bench == EngineBench::FOOD_RESPAWN)
+                    n = 100000;
+                EngineBench game;
+                game.setup(w, h, length, SEED);
+                double ns = game.run(bench, n);
+                printf("%s\n    {\"bench\": \"%s\", \"board\": \"%dx%d\", \"length\": %d, \"fill\": %.2f, "
+                       "\"iterations\": %d, \"ns_per_op\": %.2f}", first ? "" : ",", EngineBench::name(bench),
+                       w, h, length, fill, n, ns);
+                first = false;
+            }
+        }
+    printf("\n  ]\n}\n");
+}
+
+//arena mode: headless and print the leaderboard, or watch it on the terminal
+void runArena(int snakes, int w, int h, long long maxticks, uint64_t seed, bool watch){
+    const int MAX_LENGTH = 1024;
+    if(watch){
+        initscr();
+        start_color();
+        curs_set(0);
+        cbreak();
+        noecho();
+        nodelay(stdscr, TRUE);
+        const short colors[6] = {COLOR_GREEN, COLOR_BLUE, COLOR_YELLOW, COLOR_RED, COLOR_MAGENTA, COLOR_CYAN};
+        for(int i=0;i<6;i++)
+            init_pair(i+1, colors[i], COLOR_BLACK);
+        w = COLS;
+        h = LINES-1;    //the last row is the status
+    }
+    Arena arena(w, h, snakes, snakes, MAX_LENGTH, seed);
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    while(!arena.isOver() && arena.getTicks() < maxticks){
+        arena.tick();
+        if(watch){
+            erase();
+            arena.draw();
+            refresh();
+            if(getch() == 'q')
+                break;
+            napms(50);
+        }
+    }
+    double sec = chrono::duration<double>(chrono::steady_clock::now()-begin).count();
+    if(watch)
+        endwin();
+    arena.report(sec);
+}
+
+//replay a recording without ncurses, check it or stop at a tick and print the board
+int runReplay(const string& filename, long long totick){
+    Recording rec;
+    if(!rec.load(filename)){
+        fprintf(stderr, "can't read recording %s\n", filename.c_str());
+        return 1;
+    }
+    GameState game;
+    ReplayController replay(rec);
+    game.start(rec.w, rec.h, rec.seed, rec.pairs);
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    long long end = totick < 0 ? rec.ticks : totick;
+    while(!isgameover && game.getTicks() < end)
+        game.tick(replay);
+    double sec = chrono::duration<double>(chrono::steady_clock::now()-begin).count();
+    if(totick >= 0){
+        game.dump(stdout);
+        return 0;
+    }
+    printf("%s: seed %llu, %dx%d board, %zu direction changes\n", filename.c_str(),
+           (unsigned long long)rec.seed, rec.w, rec.h, rec.changes.size());
+    printf("replayed %lld ticks in %.3f ms(%.0f ticks/sec), score %d\n",
+           game.getTicks(), sec*1000, game.getTicks()/max(sec, 1e-9), game.getScore());
+    bool ok = game.getTicks() == rec.ticks && game.getScore() == rec.score;
+    printf("recorded %lld ticks, score %d: %s\n", rec.ticks, rec.score, ok ? "ok" : "MISMATCH");
+    return ok ? 0 : 2;
+}
+
 //main function
-int main(){
-    GameMain Main;
-    Main.run();
+#ifdef PROFILE_SNAKE
+void reportProfile(){
+    const char* filename = "snake-trace.json";
+    if(profiler.writeTrace(filename))
+        printf("trace written to %s\n", filename);
+    else
+        fprintf(stderr, "can't write %s\n", filename);
+    profiler.summary(stdout);
+}
+#endif
+
+int main(int argc, char** argv){
+    bool autopilot = false;
+    int games = 0;
+    int threads = max(1u, thread::hardware_concurrency());
+    int w = 80, h = 24;
+    long long maxticks = 5000;
+    uint64_t seed = time(nullptr);
+    string recordfile, replayfile;
+    long long totick = -1;
+    int arenasnakes = 0;
+    int pairs = 1;
+    bool boardset = false, watch = false;
+    for(int i=1;i<argc;i++){
+        string arg = argv[i];
+        bool hasvalue = i+1 < argc;
+        if(arg == "-a" || arg == "--auto")
+            autopilot = true;
+        else if(arg == "--bench-ai"){
+            benchAutopilot();
+            return 0;
+        }else if(arg == "--bench-collision"){
+            benchCollision();
+            return 0;
+        }else if(arg == "--bench-engine"){
+            benchEngine();
+            return 0;
+        }else if(arg == "--batch" && hasvalue)
+            games = atoi(argv[++i]);
+        else if(arg == "--threads" && hasvalue)
+            threads = max(1, atoi(argv[++i]));
+        else if(arg == "--board" && hasvalue){
+            boardset = sscanf(argv[++i], "%dx%d", &w, &h) == 2;
+            if(!boardset || w < 3 || h < 3 || w > MAX_BOARD || h > MAX_BOARD){
+                fprintf(stderr, "--board WxH, 3..%d each\n", MAX_BOARD);
+                return 1;
+            }
+        }
+        else if(arg == "--max-ticks" && hasvalue)
+            maxticks = atoll(argv[++i]);
+        else if(arg == "--seed" && hasvalue)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--record" && hasvalue)
+            recordfile = argv[++i];
+        else if(arg == "--replay" && hasvalue)
+            replayfile = argv[++i];
+        else if(arg == "--tick" && hasvalue)
+            totick = atoll(argv[++i]);
+        else if(arg == "--arena" && hasvalue){
+            arenasnakes = atoi(argv[++i]);
+            if(arenasnakes < 2){    //the arena is over when one snake is left
+                fprintf(stderr, "--arena needs at least 2 snakes\n");
+                return 1;
+            }
+        }
+        else if(arg == "--watch")
+            watch = true;
+        else if(arg == "--portals" && hasvalue)
+            pairs = max(1, min(atoi(argv[++i]), 65535));
+    }
+    if(arenasnakes > 0){
+        if(!boardset){  //about 100 cells per snake, 3:1 like a terminal
+            h = max(24, int(sqrt(arenasnakes*100/3.0)));
+            w = 3*h;
+        }
+        if((long long)w*h > MAX_ARENA_CELLS){
+            fprintf(stderr, "the arena takes at most %d cells, %dx%d is too large\n", MAX_ARENA_CELLS, w, h);
+            return 1;
+        }
+        runArena(arenasnakes, w, h, maxticks, seed, watch);
+        return 0;
+    }
+    if(!replayfile.empty()){
+        int result = runReplay(replayfile, totick);
+        #ifdef PROFILE_SNAKE
+        reportProfile();
+        #endif
+        return result;
+    }
+    if(games > 0){
+        runBatch(games, threads, w, h, maxticks, seed, pairs);
+        return 0;
+    }
+    Recording rec;
+    {
+        GameMain Main(seed, autopilot, recordfile.empty() ? nullptr : &rec, boardset ? w : 0, boardset ? h : 0, pairs);
+        Main.run();
+    }
+    #ifdef PROFILE_SNAKE
+    reportProfile();
+    #endif
+    if(!recordfile.empty() && !rec.save(recordfile)){
+        fprintf(stderr, "can't write recording %s\n", recordfile.c_str());
+        return 1;
+    }
     return 0;
 }